@@ -2,12 +2,44 @@
 #ifndef JSON_HPP
 #define JSON_HPP
 
+#include <charconv>
+#include <compare>
 #include <cstddef>
 #include <cstdint>
+#include <deque>
+#include <functional>
+#include <iterator>
 #include <map>
+#include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
+#if defined(JSON_COW) || defined(JSON_HASH_CACHE) || defined(JSON_RAW_NUMBERS) || \
+    defined(JSON_PACKED_ARRAYS)
+#include <atomic>
+#endif  // JSON_COW || JSON_HASH_CACHE || JSON_RAW_NUMBERS || JSON_PACKED_ARRAYS
+
+#ifdef JSON_PACKED_ARRAYS
+#include <span>
+#endif  // JSON_PACKED_ARRAYS
+
+#ifdef JSON_COW
+#include <unordered_map>
+#endif  // JSON_COW
+
+#ifndef __cpp_lib_atomic_shared_ptr
+#include <mutex>
+#endif  // __cpp_lib_atomic_shared_ptr
+
+#ifndef JSON_MAX_DEPTH
+#define JSON_MAX_DEPTH 16
+#endif  // JSON_MAX_DEPTH
+
 class JSON {
    public:
     enum Type {
@@ -42,17 +74,39 @@ class JSON {
         UNEXPECTED_STRING,
         UNEXPECTED_TOKEN,
 #endif  // JSON_STRICT
+        // later codes go past the strict ones whether or not they are defined, so values don't move
+        INVALID_PATCH = UNEXPECTED_STRING_END + 13,
+        INVALID_POINTER,
+        PATH_NOT_FOUND,
+        TEST_FAILED,
+        TYPE_MISMATCH,
+        INVALID_SCHEMA,
+        SCHEMA_ENUM,
+        SCHEMA_RANGE,
+        SCHEMA_REQUIRED,
+        SCHEMA_TYPE,
+        INVALID_PATH,
+        BYTES_EXCEEDED,
+        NODES_EXCEEDED,
+        STRING_LENGTH_EXCEEDED,
+        ELEMENTS_EXCEEDED,
+#ifdef JSON_VALIDATE_UTF8
+        INVALID_UTF8,
+#endif  // JSON_VALIDATE_UTF8
     };
 
     static const char* status_string(Status status);
 
     static JSON array(const std::vector<JSON>& array = {});
-    static JSON object(const std::map<std::string, JSON>& object = {});
+    static JSON array(std::vector<JSON>&& array);
+    static JSON object(const std::map<std::string, JSON, std::less<>>& object = {});
+    static JSON object(std::map<std::string, JSON, std::less<>>&& object);
 
     JSON(const std::nullptr_t = nullptr);
     JSON(bool value);
     JSON(int value);
     JSON(std::int64_t value);
+    JSON(std::uint64_t value);
     JSON(float value);
     JSON(double value);
     JSON(const char* value);
@@ -77,458 +131,3976 @@ class JSON {
 
     bool get_bool(bool fallback = {}) const;
     std::int64_t get_int64(std::int64_t fallback = {}) const;
+    std::uint64_t get_uint64(std::uint64_t fallback = {}) const;
     double get_double(double fallback = {}) const;
     std::string& get_string(const std::string& fallback = {});
+    std::string& get_string(std::string&& fallback);
     std::vector<JSON>& get_array(const std::vector<JSON>& fallback = {});
-    std::map<std::string, JSON>& get_object(const std::map<std::string, JSON>& fallback = {});
+    std::vector<JSON>& get_array(std::vector<JSON>&& fallback);
+    std::map<std::string, JSON, std::less<>>& get_object(
+        const std::map<std::string, JSON, std::less<>>& fallback = {});
+    std::map<std::string, JSON, std::less<>>& get_object(
+        std::map<std::string, JSON, std::less<>>&& fallback);
+    const std::string& get_string() const;
+    const std::vector<JSON>& get_array() const;
+    const std::map<std::string, JSON, std::less<>>& get_object() const;
+#ifdef JSON_PACKED_ARRAYS
+    // elements of a packed array, empty for other values, see JSON_PACKED_ARRAYS
+    std::span<const std::int64_t> get_int64s() const;
+    std::span<const double> get_doubles() const;
+#endif  // JSON_PACKED_ARRAYS
 
     JSON& operator[](std::size_t idx);
-    JSON& operator[](const std::string& key);
+    JSON& operator[](std::string_view key);
+    const JSON& operator[](std::size_t idx) const;
+    const JSON& operator[](std::string_view key) const;
+
+    JSON* find(std::string_view key);
+    const JSON* find(std::string_view key) const;
 
     std::size_t size() const;
     bool empty() const;
-    bool has(const std::string& key) const;
+    bool has(std::string_view key) const;
+
+    // these make the value an array or an object first, like get_array() and get_object()
+    void reserve(std::size_t capacity);
+    void push_back(JSON value);
+    template <class... Args>
+    JSON& emplace_back(Args&&... args);
+    template <class... Args>
+    JSON& emplace(std::string key, Args&&... args);  // an existing member is kept
+
+    // the contents are moved out and the value becomes null, empty for other types
+    std::string take_string();
+    std::vector<JSON> take_array();
+    std::map<std::string, JSON, std::less<>> take_object();
+
+    bool operator==(const JSON& other) const;
+    std::partial_ordering operator<=>(const JSON& other) const;
+    std::size_t hash() const;
 
     void clear();
 
+    struct Memory {  // heap bytes held by a value and its children, shared storage counted once
+        std::size_t strings = 0;  // string values, keys and raw numbers beyond the inline buffer
+        std::size_t arrays = 0;   // elements with their spare capacity, and packed numbers
+        std::size_t objects = 0;  // tree nodes of the members
+        std::size_t total() const { return strings + arrays + objects; }
+    };
+    Memory memory_usage() const;
+    // trims the spare capacity of strings, keys and arrays in the tree, storage shared with
+    // copies is left as is
+    void shrink_to_fit();
+
     bool parse(const std::string& src, Status* status = nullptr);
-    std::string dump(bool indent = false) const;
+    bool parse(const std::string& src, const JSON& projection, Status* status = nullptr);
+    struct Limits {  // checked while parsing, before the storage is allocated, 0 is no limit
+        std::size_t max_bytes = 0;  // estimated heap bytes of strings, elements and members
+        std::size_t max_nodes = 0;  // values in the tree
+        std::size_t max_string_length = 0;  // bytes of a string or key
+        std::size_t max_elements = 0;       // of an array or object
+    };
+    bool parse(const std::string& src, const Limits& limits, Status* status = nullptr);
+    class Schema;
+    bool parse(const std::string& src,
+               const Schema& schema,
+               Status* status = nullptr,
+               std::string* path = nullptr);
+    class Parser;
+    std::string dump(bool indent = false, bool ascii = false) const;
+    // rewrite the text without building a tree, members keep their order and values their
+    // spelling, comments and trailing commas are dropped, empty on failure
+    static std::string minify(std::string_view src, Status* status = nullptr);
+    static std::string prettify(std::string_view src, int indent = 2, Status* status = nullptr);
+
+    bool patch(JSON patch, Status* status = nullptr);
+    void merge_patch(JSON patch);
+    static JSON diff(const JSON& source, const JSON& target);
+
+    class Table;
+    Table to_columns() const;
+    class Path;
+
+    class Documents;
+    // documents written back to back in one buffer, see Documents
+    static Documents parse_many(std::string_view src, unsigned threads = 1);
+    class Elements;
+    // elements of a top-level array read in chunks, read returns 0 at the end, see Elements
+    static Elements parse_stream(std::function<std::size_t(char*, std::size_t)> read,
+                                 std::size_t chunk = 1 << 16);
+
+    // deeply immutable document, safe to read from any number of threads
+    std::shared_ptr<const JSON> freeze() const&;
+    std::shared_ptr<const JSON> freeze() &&;
+    class Atomic;
+#ifdef JSON_COW
+    // identical arrays and objects in the tree share their storage, and are copied again on the
+    // first write, so the tree stays safe to change, storage shared with copies isn't entered
+    void dedupe();
+#endif  // JSON_COW
+
+    template <class T>
+    static bool read(const std::string& src, T& value, Status* status = nullptr);
+    template <class T>
+    static std::string write(const T& value, bool indent = false);
+
+    class Static;
+    template <std::size_t Nodes, std::size_t Chars>
+    class Literal;
+
+    template <std::size_t N>
+    struct Source {  // string literal passed to literal() as a template argument
+        consteval Source(const char (&src)[N]) {
+            for (std::size_t i = 0; i < N; ++i)
+                chars[i] = src[i];
+        }
+        char chars[N]{};
+    };
+    template <Source S>
+    static consteval auto literal();
+
+#ifdef JSON_STATS
+    struct Stats {  // reported for every parse() and dump() while a callback is set
+        enum Phase { PARSE, DUMP };
+        Phase phase = PARSE;
+        Status status = SUCCESS;
+        std::size_t nodes[TYPE_OBJECT + 1] = {};  // indexed by Type
+        std::size_t string_bytes = 0;             // string values and keys
+        std::size_t max_depth = 0;
+        std::size_t allocations = 0;  // estimated from the sizes of strings and containers
+        std::size_t allocated_bytes = 0;
+        std::size_t bytes = 0;  // size of the source or the result
+        std::int64_t ns = 0;
+    };
+
+    // not synchronized, set it before parsing or dumping on other threads
+    static void set_stats_callback(std::function<void(const Stats&)> callback);
+#endif  // JSON_STATS
 
    private:
-    void init_string();
-    void init_array();
+    struct StaticNode {
+        Type type = TYPE_NULL;
+        std::uint32_t size = 0;    // number of elements or members, or string length
+        std::uint32_t next = 0;    // index of the node after this value
+        std::uint32_t offset = 0;  // string position in the character buffer
+        bool as_bool = false;
+        std::int64_t as_int64 = 0;
+        double as_double = 0;
+    };
+
+    struct LiteralSize {  // found by a first pass, so that literals take only what they need
+        std::size_t nodes = 0;
+        std::size_t chars = 0;
+    };
+
+    static void invalid_literal();
+    static void inexact_literal();  // number that literal() can't convert exactly, use parse()
+    static consteval LiteralSize literal_size(std::string_view src);
+    static constexpr bool unescape(const char*& start, const char* end, std::uint32_t& code);
+    static constexpr std::size_t utf8_encode(char* dst, std::uint32_t code);
+
+    struct Rule;
+    struct Scratch;
+    struct Decoder {  // state shared by all values of a single parse
+        std::string* path = nullptr;  // pointer to the value that failed validation
+        Scratch* scratch = nullptr;   // storage to reuse instead of allocating
+        const Limits* limits = nullptr;
+        std::size_t nodes = 0;  // charged against the limits
+        std::size_t bytes = 0;
+#ifdef JSON_STATS
+        Stats* stats = nullptr;
+#endif  // JSON_STATS
+    };
+
+#ifdef JSON_COW
+    template <class T>
+    struct Shared {  // reference counted storage, copied on the first write
+        std::atomic<std::size_t> refs;
+        T value;
+    };
+
+    template <class T>
+    static T& detach(Shared<T>*& shared);
+    template <class T>
+    static void release(Shared<T>* shared);
+#endif  // JSON_COW
+
+#ifdef JSON_RAW_NUMBERS
+    struct Raw {  // number as it was parsed, converted on the first access
+        std::string text;
+        mutable std::atomic<bool> converted{false};
+        mutable std::atomic<bool> overflow{false};   // integer that doesn't fit into int64
+        mutable std::atomic<std::uint64_t> bits{0};  // int64 or double, depending on the type
+    };
+
+    std::uint64_t convert() const;
+#endif  // JSON_RAW_NUMBERS
+#ifdef JSON_PACKED_ARRAYS
+    struct Packed {  // array of only int64 or only double values
+        Type type;     // of the elements, decides which of the vectors is used
+        std::vector<std::int64_t> int64s;
+        std::vector<double> doubles;
+        mutable std::atomic<std::vector<JSON>*> nodes{nullptr};  // expanded for const access
+#ifdef JSON_COW
+        std::atomic<std::size_t> refs{1};  // shared by copies, like Shared
+#endif  // JSON_COW
+    };
+
+    static constexpr std::size_t PACKED_MIN = 8;  // smaller arrays stay as nodes
+
+    static Packed* pack(std::span<const JSON> values);
+    static std::vector<JSON> expand(const Packed& packed);
+    static void release(Packed* packed);
+    void unpack();
+#endif  // JSON_PACKED_ARRAYS
+    std::int64_t int64_value() const;
+    double double_value() const;
+    bool overflows() const;  // raw integer that doesn't fit into int64
+    std::partial_ordering compare_integer(const JSON& other) const;
+    std::partial_ordering compare_double(double value) const;
+    void warm() const;
+    std::size_t hash(bool memoize) const;
+    template <class F>
+    void each_element(F&& f) const;
+    template <class F>
+    decltype(auto) with_element(std::size_t idx, F&& f) const;
+
+    std::vector<JSON>& elements();
+    const std::vector<JSON>& elements() const;
+    std::map<std::string, JSON, std::less<>>& members();
+    const std::map<std::string, JSON, std::less<>>& members() const;
+    bool shares(const JSON& other) const;
+#ifdef JSON_COW
+    bool identical(const JSON& other) const;
+    std::size_t dedupe(std::unordered_map<std::size_t, std::vector<const JSON*>>& seen);
+#endif  // JSON_COW
+
+    void init_string(Scratch* scratch = nullptr);
+    void init_array(Scratch* scratch = nullptr);
     void init_object();
+    void recycle(Scratch& scratch);
+
+    enum {  // ctx, represents where we are and what to expect
+        CTX_OBJECT = 1 << 1,
+        CTX_ARRAY = 1 << 2,
+        CTX_KEY = 1 << 3,
+        CTX_COLON = 1 << 4,
+        CTX_COMMA = 1 << 5,
+    };
+
+    static const JSON SKIP;  // projection that validates a value without keeping it, by address
+    static const JSON* project(const JSON& selected);
+    static Status scan(const char*& start, const char* end, int& ctx, std::size_t depth);
+    static void string_escape(std::string& dst, std::string_view src, bool ascii = false);
+    static Status reformat(std::string_view src, std::string& dst, bool pretty, int indent);
 
-    Status decode(const char*& start, const char* end, int ctx, std::size_t depth);
-    void encode(std::string& dst, bool pretty, int indent) const;
+    template <class T>
+    static Status bind(const char*& start, const char* end, int ctx, std::size_t depth, T& value);
+    template <class T>
+    static void emit(std::string& dst, const T& value, bool pretty, int indent);
+
+    Status decode(const std::string& src,
+                  const JSON* projection,
+                  const Rule* rule,
+                  Decoder& decoder);
+    Status decode(const char*& start,
+                  const char* end,
+                  int ctx,
+                  std::size_t depth,
+                  const JSON* projection,
+                  const Rule* rule = nullptr,
+                  Decoder* decoder = nullptr);
+    Status validate(const Rule& rule) const;
+    static void failed(Decoder* decoder, Status status, std::string_view segment);
+    static Status charge(Decoder* decoder, std::size_t nodes, std::size_t bytes);
+    static Status fits(const Decoder* decoder, std::size_t length);
+#ifdef JSON_STATS
+    static std::function<void(const Stats&)>& stats_callback();
+    void count(Stats& stats, std::size_t depth) const;
+    void collect(Stats& stats, std::size_t depth) const;
+#endif  // JSON_STATS
+    void measure(Memory& memory, std::unordered_set<const void*>& seen) const;
+    void encode(std::string& dst, bool pretty, int indent, bool ascii = false) const;
+
+    struct Undo;
+    Status apply(JSON& op, std::vector<Undo>& undo);
+    Status place(const std::string& kind,
+                 const std::string& dst,
+                 JSON& value,
+                 std::vector<Undo>& undo);
+    void rollback(std::vector<Undo>& undo);
+    JSON* resolve(std::string_view path, std::string& key, bool parent);
+    static void diff(std::vector<JSON>& ops,
+                     std::string& path,
+                     const JSON& source,
+                     const JSON& target);
 
     Type type_;
+#ifdef JSON_RAW_NUMBERS
+    bool raw_ = false;  // int64 or double stored as as_raw_
+#endif  // JSON_RAW_NUMBERS
+#ifdef JSON_PACKED_ARRAYS
+    bool packed_ = false;  // array stored as as_packed_
+#endif  // JSON_PACKED_ARRAYS
     union {
         bool as_bool_;
         std::int64_t as_int64_;
         double as_double_;
         std::string as_string_;
+#ifdef JSON_RAW_NUMBERS
+        Raw as_raw_;
+#endif  // JSON_RAW_NUMBERS
+#ifdef JSON_PACKED_ARRAYS
+        Packed* as_packed_;
+#endif  // JSON_PACKED_ARRAYS
+#ifdef JSON_COW
+        Shared<std::vector<JSON>>* as_array_;
+        Shared<std::map<std::string, JSON, std::less<>>>* as_object_;
+#else   // JSON_COW
         std::vector<JSON> as_array_;
-        std::map<std::string, JSON> as_object_;
+        std::map<std::string, JSON, std::less<>> as_object_;
+#endif  // JSON_COW
     };
+#ifdef JSON_HASH_CACHE
+    mutable std::atomic<std::size_t> hash_{0};  // 0 if not computed yet
+#endif  // JSON_HASH_CACHE
 };
 
-#endif  // JSON_HPP
-
-#ifdef JSON_IMPLEMENTATION
-
-#include <cassert>
-#include <cctype>
-#include <charconv>
-#include <cstdio>
-#include <cstring>
-#include <iterator>
-#include <utility>
+template <>
+struct std::hash<JSON> {
+    std::size_t operator()(const JSON& json) const { return json.hash(); }
+};
 
-#ifndef JSON_MAX_DEPTH
-#define JSON_MAX_DEPTH 16
-#endif  // JSON_MAX_DEPTH
+// JSON_FIELDS(Type, field1, field2, ...) makes a struct readable and writable with
+// JSON::read() and JSON::write(), place it in the namespace of the struct
+#define JSON_FIELDS(Type, ...)                                         \
+    template <class Self, class F>                                     \
+        requires std::is_same_v<std::remove_const_t<Self>, Type>       \
+    void json_fields(Self& self, F&& f) {                              \
+        __VA_OPT__(JSON_FOR_EACH_EXPAND(JSON_FOR_EACH(__VA_ARGS__)))   \
+    }
 
-static void string_escape(std::string& dst, const std::string& src);
+#define JSON_FOR_EACH(field, ...) \
+    f(#field, self.field);        \
+    __VA_OPT__(JSON_FOR_EACH_AGAIN JSON_FOR_EACH_PARENS(__VA_ARGS__))
+#define JSON_FOR_EACH_AGAIN() JSON_FOR_EACH
+#define JSON_FOR_EACH_PARENS ()
+#define JSON_FOR_EACH_EXPAND(...) \
+    JSON_FOR_EACH_EXPAND3(JSON_FOR_EACH_EXPAND3(JSON_FOR_EACH_EXPAND3(__VA_ARGS__)))
+#define JSON_FOR_EACH_EXPAND3(...) \
+    JSON_FOR_EACH_EXPAND2(JSON_FOR_EACH_EXPAND2(JSON_FOR_EACH_EXPAND2(__VA_ARGS__)))
+#define JSON_FOR_EACH_EXPAND2(...) \
+    JSON_FOR_EACH_EXPAND1(JSON_FOR_EACH_EXPAND1(JSON_FOR_EACH_EXPAND1(__VA_ARGS__)))
+#define JSON_FOR_EACH_EXPAND1(...) __VA_ARGS__
 
-const char* JSON::status_string(Status status) {
-    switch (status) {
-        case SUCCESS:
-            return "SUCCESS";
-        case END:
-            return "END";
-        case DEPTH_EXCEEDED:
-            return "DEPTH_EXCEEDED";
-        case INVALID_KEY_TYPE:
-            return "INVALID_KEY_TYPE";
-        case INVALID_STRING_ESCAPE:
-            return "INVALID_STRING_ESCAPE";
-        case INVALID_TOKEN:
-            return "INVALID_TOKEN";
-        case UNEXPECTED_STRING_END:
-            return "UNEXPECTED_STRING_END";
+template <class T>
+bool JSON::read(const std::string& src, T& value, Status* status) {
+    const char* start = src.data();
+    const char* end = src.data() + src.size();
+    Status s1 = bind(start, end, 0, 0, value);
 #ifdef JSON_STRICT
-        case INVALID_NUMBER:
-            return "INVALID_NUMBER";
-        case TRAILING_CONTENT:
-            return "TRAILING_CONTENT";
-        case UNEXPECTED_ARRAY:
-            return "UNEXPECTED_ARRAY";
-        case UNEXPECTED_ARRAY_END:
-            return "UNEXPECTED_ARRAY_END";
-        case UNEXPECTED_COLON:
-            return "UNEXPECTED_COLON";
-        case UNEXPECTED_COMMA:
-            return "UNEXPECTED_COMMA";
-        case UNEXPECTED_END:
-            return "UNEXPECTED_END";
-        case UNEXPECTED_NUMBER:
-            return "UNEXPECTED_NUMBER";
-        case UNEXPECTED_OBJECT:
-            return "UNEXPECTED_OBJECT";
-        case UNEXPECTED_OBJECT_END:
-            return "UNEXPECTED_OBJECT_END";
-        case UNEXPECTED_STRING:
-            return "UNEXPECTED_STRING";
-        case UNEXPECTED_TOKEN:
-            return "UNEXPECTED_TOKEN";
-#endif  // JSON_STRICT
-        default:
-            assert(false);
-            return "UNKNOWN_STATUS";
+    if (s1 == SUCCESS) {
+        int ctx = 0;
+        Status s2 = scan(start, end, ctx, 0);
+        if (s2 != END)
+            s1 = TRAILING_CONTENT;
     }
+#endif  // JSON_STRICT
+    if (status != nullptr)
+        *status = s1;
+    return s1 == SUCCESS;
 }
 
-JSON JSON::array(const std::vector<JSON>& array) {
-    JSON json;
-    json.init_array();
-    json.as_array_ = std::move(array);
-    return json;
+template <class T>
+std::string JSON::write(const T& value, bool pretty) {
+    std::string string;
+    emit(string, value, pretty, 1);
+    return string;
 }
 
-JSON JSON::object(const std::map<std::string, JSON>& object) {
-    JSON json;
-    json.init_object();
-    json.as_object_ = std::move(object);
-    return json;
+template <class... Args>
+JSON& JSON::emplace_back(Args&&... args) {
+    return get_array().emplace_back(std::forward<Args>(args)...);
 }
 
-JSON::JSON(const std::nullptr_t) : type_{TYPE_NULL} {}
-JSON::JSON(bool value) : type_{TYPE_BOOL}, as_bool_{value} {}
-JSON::JSON(int value) : type_{TYPE_INT64}, as_int64_{value} {}
-JSON::JSON(std::int64_t value) : type_{TYPE_INT64}, as_int64_{value} {}
-JSON::JSON(float value) : type_{TYPE_DOUBLE}, as_double_{value} {}
-JSON::JSON(double value) : type_{TYPE_DOUBLE}, as_double_{value} {}
-JSON::JSON(const char* value) : type_{TYPE_STRING}, as_string_{value} {}
-JSON::JSON(std::string&& value) : type_{TYPE_STRING}, as_string_{std::move(value)} {}
-JSON::JSON(const std::string& value) : type_{TYPE_STRING}, as_string_{std::move(value)} {}
-
-JSON::~JSON() {
-    clear();
+template <class... Args>
+JSON& JSON::emplace(std::string key, Args&&... args) {
+    return get_object().try_emplace(std::move(key), std::forward<Args>(args)...).first->second;
 }
 
-JSON::JSON(const JSON& other) : type_{other.type_} {
-    switch (type_) {
-        case TYPE_NULL:
-            break;
-        case TYPE_BOOL: {
-            as_bool_ = other.as_bool_;
-        } break;
-        case TYPE_INT64: {
-            as_int64_ = other.as_int64_;
-        } break;
-        case TYPE_DOUBLE: {
-            as_double_ = other.as_double_;
-        } break;
-        case TYPE_STRING: {
-            new (&as_string_) std::string{other.as_string_};
-        } break;
-        case TYPE_ARRAY: {
-            new (&as_array_) std::vector{other.as_array_};
-        } break;
-        case TYPE_OBJECT: {
-            new (&as_object_) std::map{other.as_object_};
-        } break;
-        default:
-            assert(false);
+template <class T>
+JSON::Status JSON::bind(const char*& start,
+                        const char* end,
+                        int ctx,
+                        std::size_t depth,
+                        T& value) {
+    if constexpr (requires {
+                      typename T::value_type;
+                      requires std::is_same_v<T, std::optional<typename T::value_type>>;
+                  }) {
+        Status status = scan(start, end, ctx, depth);
+        if (status != SUCCESS)
+            return status;
+        if (*start != 'n')
+            return bind(start, end, ctx, depth, value.emplace());
+        JSON json;
+        value.reset();
+        return json.decode(start, end, ctx, depth, nullptr);
+    } else if constexpr (requires {
+                             typename T::value_type;
+                             requires std::is_same_v<T, std::vector<typename T::value_type>>;
+                         }) {
+        if (depth > JSON_MAX_DEPTH)
+            return DEPTH_EXCEEDED;
+        Status status = scan(start, end, ctx, depth);
+        if (status != SUCCESS)
+            return status;
+        if (*start != '[')
+            return TYPE_MISMATCH;
+#ifdef JSON_STRICT
+        if (ctx & (CTX_KEY | CTX_COLON | CTX_COMMA))
+            return UNEXPECTED_ARRAY;
+#endif  // JSON_STRICT
+        ++start;
+        value.clear();
+        ctx = CTX_ARRAY;
+        for (;;) {
+            status = scan(start, end, ctx, depth + 1);
+            if (status != SUCCESS)
+                return status;
+            if (*start == ']') {
+                ++start;
+                return SUCCESS;
+            }
+            status = bind(start, end, ctx, depth + 1, value.emplace_back());
+            if (status != SUCCESS)
+                return status;
+            ctx = CTX_ARRAY | CTX_COMMA;
+        }
+    } else if constexpr (requires(T& v) { json_fields(v, [](const char*, auto&) {}); }) {
+        if (depth > JSON_MAX_DEPTH)
+            return DEPTH_EXCEEDED;
+        Status status = scan(start, end, ctx, depth);
+        if (status != SUCCESS)
+            return status;
+        if (*start != '{')
+            return TYPE_MISMATCH;
+#ifdef JSON_STRICT
+        if (ctx & (CTX_KEY | CTX_COLON | CTX_COMMA))
+            return UNEXPECTED_OBJECT;
+#endif  // JSON_STRICT
+        ++start;
+        ctx = CTX_OBJECT | CTX_KEY;
+        JSON key, skipped;
+        for (;;) {
+            status = key.decode(start, end, ctx, depth + 1, nullptr);
+            if (status == END)
+                return SUCCESS;
+            if (status != SUCCESS)
+                return status;
+            if (key.type() != TYPE_STRING)
+                return INVALID_KEY_TYPE;
+            bool found = false;
+            json_fields(value, [&](const char* name, auto& field) {
+                if (!found && key.as_string_ == name) {
+                    found = true;
+                    status = bind(start, end, CTX_COLON, depth + 1, field);
+                }
+            });
+            if (!found)
+                status = skipped.decode(start, end, CTX_COLON, depth + 1, &SKIP);
+            if (status != SUCCESS)
+                return status;
+            ctx = CTX_OBJECT | CTX_KEY | CTX_COMMA;
+        }
+    } else {
+        JSON json;
+        Status status = json.decode(start, end, ctx, depth, nullptr);
+        if (status != SUCCESS)
+            return status;
+        if constexpr (std::is_same_v<T, JSON>) {
+            value = std::move(json);
+        } else if constexpr (std::is_same_v<T, bool>) {
+            if (!json.is_bool())
+                return TYPE_MISMATCH;
+            value = json.as_bool_;
+        } else if constexpr (std::is_integral_v<T>) {
+            if (!json.is_int64())
+                return TYPE_MISMATCH;
+            if constexpr (std::is_unsigned_v<T>) {
+                // get_uint64() is 0 for negative values and raw text beyond uint64
+                std::uint64_t uint64 = json.get_uint64();
+                if ((uint64 == 0 && json.int64_value() != 0) || !std::in_range<T>(uint64))
+                    return TYPE_MISMATCH;
+                value = static_cast<T>(uint64);
+            } else {
+                std::int64_t int64 = json.int64_value();
+                if (json.overflows() || !std::in_range<T>(int64))
+                    return TYPE_MISMATCH;
+                value = static_cast<T>(int64);
+            }
+        } else if constexpr (std::is_floating_point_v<T>) {
+            if (!json.is_int64() && !json.is_double())
+                return TYPE_MISMATCH;
+            value = static_cast<T>(json.get_double());
+        } else {
+            static_assert(std::is_same_v<T, std::string>, "type isn't supported by JSON::read");
+            if (!json.is_string())
+                return TYPE_MISMATCH;
+            value = std::move(json.as_string_);
+        }
+        return SUCCESS;
     }
 }
 
-JSON& JSON::operator=(const JSON& other) {
-    if (this != &other) {
-        clear();
-        type_ = other.type_;
-
-        switch (type_) {
-            case TYPE_NULL:
-                break;
-            case TYPE_BOOL: {
-                as_bool_ = other.as_bool_;
-            } break;
-            case TYPE_INT64: {
-                as_int64_ = other.as_int64_;
-            } break;
-            case TYPE_DOUBLE: {
-                as_double_ = other.as_double_;
-            } break;
-            case TYPE_STRING: {
-                new (&as_string_) std::string{other.as_string_};
-            } break;
-            case TYPE_ARRAY: {
-                new (&as_array_) std::vector{other.as_array_};
-            } break;
-            case TYPE_OBJECT: {
-                new (&as_object_) std::map{other.as_object_};
-            } break;
-            default:
-                assert(false);
+template <class T>
+void JSON::emit(std::string& dst, const T& value, bool pretty, int indent) {
+    if constexpr (requires {
+                      typename T::value_type;
+                      requires std::is_same_v<T, std::optional<typename T::value_type>>;
+                  }) {
+        if (value.has_value())
+            emit(dst, *value, pretty, indent);
+        else
+            dst += "null";
+    } else if constexpr (requires {
+                             typename T::value_type;
+                             requires std::is_same_v<T, std::vector<typename T::value_type>>;
+                         }) {
+        dst += pretty ? "[\n" : "[";
+        for (auto it = value.begin(); it != value.end(); ++it) {
+            if (pretty) {
+                for (int i = 0; i < indent; ++i)
+                    dst += "  ";
+            }
+            emit(dst, *it, pretty, indent + 1);
+            if (std::next(it) != value.end())
+                dst += ',';
+            if (pretty)
+                dst += '\n';
         }
+        if (pretty) {
+            for (int i = 0; i < indent - 1; ++i)
+                dst += "  ";
+        }
+        dst += ']';
+    } else if constexpr (requires(const T& v) { json_fields(v, [](const char*, auto&) {}); }) {
+        dst += pretty ? "{\n" : "{";
+        bool first = true;
+        json_fields(value, [&](const char* name, const auto& field) {
+            if (!first)
+                dst += pretty ? ",\n" : ",";
+            first = false;
+            if (pretty) {
+                for (int i = 0; i < indent; ++i)
+                    dst += "  ";
+            }
+            string_escape(dst, name);
+            dst += pretty ? ": " : ":";
+            emit(dst, field, pretty, indent + 1);
+        });
+        if (pretty) {
+            if (!first)
+                dst += '\n';
+            for (int i = 0; i < indent - 1; ++i)
+                dst += "  ";
+        }
+        dst += '}';
+    } else if constexpr (std::is_same_v<T, JSON>) {
+        value.encode(dst, pretty, indent);
+    } else if constexpr (std::is_same_v<T, bool>) {
+        dst += value ? "true" : "false";
+    } else if constexpr (std::is_integral_v<T>) {
+        char buf[24];  // unsigned values above INT64_MAX too
+        dst.append(buf, std::to_chars(buf, buf + sizeof(buf), value).ptr);
+    } else if constexpr (std::is_floating_point_v<T>) {
+        JSON{static_cast<double>(value)}.encode(dst, pretty, indent);
+    } else {
+        static_assert(std::is_convertible_v<const T&, std::string_view>,
+                      "type isn't supported by JSON::write");
+        string_escape(dst, value);
     }
-
-    return *this;
 }
 
-JSON::JSON(JSON&& other) noexcept : type_{other.type_} {
-    other.type_ = TYPE_NULL;
+struct JSON::Rule {  // compiled schema of a single value
+    int types = 0;      // bitmask of 1 << Type, 0 accepts any type
+    std::vector<std::string> required;
+    std::map<std::string, const Rule*, std::less<>> properties;
+    const Rule* items = nullptr;
+    std::optional<double> minimum;
+    std::optional<double> maximum;
+    std::size_t min_length = 0;  // code points
+    std::size_t max_length = SIZE_MAX;
+    std::size_t min_items = 0;
+    std::size_t max_items = SIZE_MAX;
+    std::vector<JSON> values;  // enum, empty accepts any value
+};
 
-    switch (type_) {
-        case TYPE_NULL:
-            break;
-        case TYPE_BOOL: {
-            as_bool_ = other.as_bool_;
-        } break;
-        case TYPE_INT64: {
-            as_int64_ = other.as_int64_;
-        } break;
-        case TYPE_DOUBLE: {
-            as_double_ = other.as_double_;
-        } break;
-        case TYPE_STRING: {
-            new (&as_string_) std::string{std::move(other.as_string_)};
-        } break;
-        case TYPE_ARRAY: {
-            new (&as_array_) std::vector{std::move(other.as_array_)};
-        } break;
-        case TYPE_OBJECT: {
-            new (&as_object_) std::map{std::move(other.as_object_)};
-        } break;
-        default:
-            assert(false);
-    }
-}
+struct JSON::Undo {  // a change made by patch(), reverted in reverse order when an op fails
+    enum Kind {
+        INSERTED,  // the value at the path is new
+        ERASED,    // the value was removed, and is held here
+        REPLACED,  // the value was overwritten, the old one is held here
+        MOVED,     // the value was removed by a move, it's taken back from where it was moved to
+    };
+    Kind kind;
+    std::string path;  // pointer to the value, with array indices resolved
+    JSON value;
+};
 
-JSON& JSON::operator=(JSON&& other) noexcept {
-    if (this != &other) {
-        clear();
+struct JSON::Scratch {  // emptied storage of released values, with its capacity
+    std::vector<std::string> strings;
+    std::vector<std::vector<JSON>> arrays;
+    std::vector<std::map<std::string, JSON, std::less<>>::node_type> members;
+    std::vector<JSON> elements;  // of the arrays being decoded, moved out when they end
+};
+
+// subset of JSON Schema checked by JSON::parse() while decoding: type, properties, required,
+// items, minimum, maximum, minLength, maxLength, minItems, maxItems and enum
+class JSON::Schema {
+   public:
+    Schema() = default;
+    Schema(const Schema&) = delete;
+    Schema& operator=(const Schema&) = delete;
+    Schema(Schema&&) = default;
+    Schema& operator=(Schema&&) = default;
+
+    bool compile(const JSON& schema, Status* status = nullptr);
+
+   private:
+    friend class JSON;
+
+    const Rule* add(const JSON& schema);
+
+    std::deque<Rule> rules_;  // stable addresses, rules point to each other
+    const Rule* root_ = nullptr;
+};
+
+// parses documents one after another into the same or different values, the strings, arrays
+// and object members of the replaced values are kept and reused by the next parse, so
+// documents of a similar shape are parsed with few allocations
+class JSON::Parser {
+   public:
+    bool parse(JSON& json, const std::string& src, Status* status = nullptr);
+    void clear();  // frees the kept storage
+
+   private:
+    Scratch scratch_;
+};
+
+// array of objects stored as columns, one per key, with a row per element of the array,
+// elements that aren't objects are rows of nulls
+class JSON::Table {
+   public:
+    struct Column {
+        Type type = TYPE_NULL;  // of the values, int64 is widened to double if both appear
+        bool mixed = false;     // values of other different types, all kept in values
+        std::vector<bool> nulls;  // rows where the key is missing or the value is null
+        std::vector<bool> bools;  // one of the vectors below has a value for every row
+        std::vector<std::int64_t> int64s;
+        std::vector<double> doubles;
+        std::vector<std::string> strings;
+        std::vector<JSON> values;  // arrays, objects and mixed values
+    };
+
+    std::size_t rows() const { return rows_; }
+    const std::map<std::string, Column, std::less<>>& columns() const { return columns_; }
+    const Column* column(std::string_view key) const;
+
+    // fills the columns straight from the source, without building the objects
+    bool parse(const std::string& src, Status* status = nullptr);
+
+   private:
+    friend class JSON;
+
+    Status decode(const char*& start, const char* end);
+    void add(std::string_view key, JSON value);
+    void end_row();
+    static void append(Column& column, JSON value);
+    static void mix(Column& column);
+
+    std::map<std::string, Column, std::less<>> columns_;
+    std::size_t rows_ = 0;
+};
+
+// JSONPath subset compiled once and run over documents or their source: $, .name, ['name'],
+// .*, [*], ..name, ..*, ..[...], [index], [start:end:step] and filters like [?(@.key)] and
+// [?(@.key op literal)] with ==, !=, <, <=, >, >=
+class JSON::Path {
+   public:
+    bool compile(std::string_view path, Status* status = nullptr);
+
+    // results are in document order, members are visited by key in trees and as written in text
+    std::vector<const JSON*> select(const JSON& json) const;
+    // views of the matched values in the source, non-matching values are only tokenized
+    std::vector<std::string_view> select_text(std::string_view src,
+                                              Status* status = nullptr) const;
+
+   private:
+    struct Step {
+        enum Kind { NAME, WILDCARD, INDEX, SLICE, FILTER };
+        enum Op { EXISTS, EQ, NE, LT, LE, GT, GE };
+        Kind kind = WILDCARD;
+        bool recursive = false;  // applies to the descendants too
+        std::string name;
+        std::int64_t start = 0;  // index, or the slice [start:end:step]
+        std::int64_t end = INT64_MAX;
+        std::int64_t step = 1;
+        std::vector<std::string> keys;  // of the filter, relative to @
+        Op op = EXISTS;
+        JSON value;
+    };
+
+    static bool bracket(const char*& p, const char* end, Step& step);
+    static bool filter(const char*& p, const char* end, Step& step);
+    static bool selects(const Step& step, bool object, std::string_view key, std::size_t idx,
+                        std::size_t length);
+    static bool test(const Step& step, const JSON& value);
+
+    void select(const JSON& json, std::size_t step, std::vector<const JSON*>& results) const;
+    Status match(const char*& start,
+                 const char* end,
+                 int ctx,
+                 std::size_t depth,
+                 std::size_t step,
+                 std::vector<std::string_view>& views) const;
+
+    std::vector<Step> steps_;
+};
+
+// documents written back to back in one buffer, like newline delimited json or batches of
+// concatenated values, decoded one at a time into the same reused storage
+class JSON::Documents {
+   public:
+    struct Document {
+        JSON json;
+        std::size_t offset = 0;  // of the first byte of the document in the buffer
+        Status status = SUCCESS;
+    };
+
+    class iterator {
+       public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = Document;
+        using difference_type = std::ptrdiff_t;
+        using pointer = Document*;
+        using reference = Document&;
+
+        Document& operator*() const { return *documents_->current_; }
+        Document* operator->() const { return documents_->current_; }
+        iterator& operator++();
+        void operator++(int) { ++*this; }
+        bool operator==(const iterator& other) const = default;
+
+       private:
+        friend class Documents;
+        Documents* documents_ = nullptr;  // null at the end
+    };
+
+    // with more than one thread the buffer is split first and the documents are decoded by
+    // all threads up front, otherwise each document is decoded when the iterator reaches it
+    explicit Documents(std::string_view src, unsigned threads = 1);
+    Documents(const Documents&) = delete;  // iterators point into it
+    Documents& operator=(const Documents&) = delete;
+
+    iterator begin();
+    iterator end() { return {}; }
+
+   private:
+    bool next();
+    // decodes the document at offset_ and moves past it, or to the next line if it's invalid
+    bool next(Document& document, const JSON* projection, Scratch* scratch);
+
+    std::string_view src_;
+    std::size_t offset_ = 0;
+    Scratch scratch_;
+    Document document_;
+    Document* current_ = nullptr;
+    std::vector<Document> batch_;  // decoded up front
+    std::size_t idx_ = 0;
+    bool threaded_ = false;
+};
+
+// elements of a top-level array read from a stream through a bounded buffer and decoded one
+// at a time, only the unread text and the current element are kept in memory
+class JSON::Elements {
+   public:
+    using Read = std::function<std::size_t(char* buffer, std::size_t size)>;
+
+    class iterator {
+       public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = JSON;
+        using difference_type = std::ptrdiff_t;
+        using pointer = JSON*;
+        using reference = JSON&;
+
+        JSON& operator*() const { return elements_->current_; }
+        JSON* operator->() const { return &elements_->current_; }
+        iterator& operator++();
+        void operator++(int) { ++*this; }
+        bool operator==(const iterator& other) const = default;
+
+       private:
+        friend class Elements;
+        Elements* elements_ = nullptr;  // null at the end
+    };
+
+    explicit Elements(Read read, std::size_t chunk = 1 << 16);
+    Elements(const Elements&) = delete;  // iterators point into it
+    Elements& operator=(const Elements&) = delete;
+
+    iterator begin();
+    iterator end() { return {}; }
+
+    // SUCCESS once the whole array was read, otherwise why the elements stopped
+    Status status() const { return status_; }
+
+   private:
+    bool next();
+    bool fill();
+    std::size_t extent(std::size_t first);
+
+    Read read_;
+    std::size_t chunk_;
+    std::string buffer_;
+    std::size_t pos_ = 0;  // of the unread text in the buffer
+    int ctx_ = 0;
+    // where extent() stopped in an element that isn't buffered whole, so that a long element is
+    // scanned once instead of again after every chunk
+    std::size_t scan_first_ = std::string::npos;
+    std::size_t scan_next_ = 0;
+    std::size_t scan_depth_ = 0;
+    bool scan_string_ = false;
+    bool scan_comment_ = false;
+    bool eof_ = false;
+    bool opened_ = false;  // the [ was read
+    bool closed_ = false;  // the ] was read
+    bool begun_ = false;
+    bool more_ = false;
+    Status status_ = SUCCESS;
+    Scratch scratch_;
+    JSON current_;
+};
+
+// holds the current frozen document, load() returns a snapshot that stays valid for as long
+// as the reader keeps it, the replaced documents are freed by their last reader
+class JSON::Atomic {
+   public:
+    Atomic();
+    explicit Atomic(std::shared_ptr<const JSON> json);
+    Atomic(const Atomic&) = delete;
+    Atomic& operator=(const Atomic&) = delete;
+
+    std::shared_ptr<const JSON> load() const;
+    void store(std::shared_ptr<const JSON> json);
+    std::shared_ptr<const JSON> exchange(std::shared_ptr<const JSON> json);
+
+   private:
+#ifdef __cpp_lib_atomic_shared_ptr
+    std::atomic<std::shared_ptr<const JSON>> json_;
+#else   // __cpp_lib_atomic_shared_ptr
+    mutable std::mutex mutex_;  // only held to copy or swap the pointer
+    std::shared_ptr<const JSON> json_;
+#endif  // __cpp_lib_atomic_shared_ptr
+};
+
+// read-only view into a document parsed at compile time by JSON::literal()
+class JSON::Static {
+   public:
+    constexpr Static() = default;
+
+    constexpr Type type() const { return idx_ != MISSING ? nodes_[idx_].type : TYPE_NULL; }
+
+    constexpr bool is_null() const { return type() == TYPE_NULL; }
+    constexpr bool is_bool() const { return type() == TYPE_BOOL; }
+    constexpr bool is_int64() const { return type() == TYPE_INT64; }
+    constexpr bool is_double() const { return type() == TYPE_DOUBLE; }
+    constexpr bool is_string() const { return type() == TYPE_STRING; }
+    constexpr bool is_array() const { return type() == TYPE_ARRAY; }
+    constexpr bool is_object() const { return type() == TYPE_OBJECT; }
+
+    constexpr bool get_bool(bool fallback = {}) const {
+        return is_bool() ? nodes_[idx_].as_bool : fallback;
+    }
+
+    constexpr std::int64_t get_int64(std::int64_t fallback = {}) const {
+        switch (type()) {
+            case TYPE_INT64:
+                return nodes_[idx_].as_int64;
+            case TYPE_DOUBLE:
+                return nodes_[idx_].as_double;
+            default:
+                return fallback;
+        }
+    }
+
+    constexpr double get_double(double fallback = {}) const {
+        switch (type()) {
+            case TYPE_INT64:
+                return nodes_[idx_].as_int64;
+            case TYPE_DOUBLE:
+                return nodes_[idx_].as_double;
+            default:
+                return fallback;
+        }
+    }
+
+    constexpr std::string_view get_string(std::string_view fallback = {}) const {
+        if (!is_string())
+            return fallback;
+        return {chars_ + nodes_[idx_].offset, nodes_[idx_].size};
+    }
+
+    constexpr Static operator[](std::size_t idx) const {
+        if (!is_array() || idx >= nodes_[idx_].size)
+            return {};
+        std::uint32_t node = idx_ + 1;
+        while (idx-- > 0)
+            node = nodes_[node].next;
+        return {nodes_, chars_, node};
+    }
+
+    constexpr Static operator[](std::string_view key) const {
+        if (!is_object())
+            return {};
+        std::uint32_t node = idx_ + 1;  // key, followed by the value
+        for (std::uint32_t i = 0; i < nodes_[idx_].size; ++i) {
+            if (std::string_view{chars_ + nodes_[node].offset, nodes_[node].size} == key)
+                return {nodes_, chars_, node + 1};
+            node = nodes_[node + 1].next;
+        }
+        return {};
+    }
+
+    constexpr std::size_t size() const {
+        switch (type()) {
+            case TYPE_STRING:
+            case TYPE_ARRAY:
+            case TYPE_OBJECT:
+                return nodes_[idx_].size;
+            default:
+                return 0;
+        }
+    }
+
+    constexpr bool empty() const { return size() == 0; }
+    constexpr bool has(std::string_view key) const { return (*this)[key].idx_ != MISSING; }
+
+    JSON to_json() const;
+
+   private:
+    template <std::size_t Nodes, std::size_t Chars>
+    friend class JSON::Literal;
+
+    static constexpr std::uint32_t MISSING = UINT32_MAX;
+
+    constexpr Static(const StaticNode* nodes, const char* chars, std::uint32_t idx)
+        : nodes_{nodes}, chars_{chars}, idx_{idx} {}
+
+    const StaticNode* nodes_ = nullptr;
+    const char* chars_ = nullptr;
+    std::uint32_t idx_ = MISSING;
+};
+
+// reads the four hex digits after \u, and the following \u escape if they're a high
+// surrogate followed by a low one, unpaired surrogates are returned as is
+constexpr bool JSON::unescape(const char*& start, const char* end, std::uint32_t& code) {
+    auto hex = [&](std::uint32_t& value) {
+        if (end - start < 4)
+            return false;
+        value = 0;
+        for (const char* last = start + 4; start < last; ++start) {
+            char c = *start;
+            if (c >= '0' && c <= '9')
+                value = value << 4 | (c - '0');
+            else if (c >= 'a' && c <= 'f')
+                value = value << 4 | (c - 'a' + 10);
+            else if (c >= 'A' && c <= 'F')
+                value = value << 4 | (c - 'A' + 10);
+            else
+                return false;
+        }
+        return true;
+    };
+
+    if (!hex(code))
+        return false;
+    if (code >= 0xD800 && code <= 0xDBFF && end - start >= 6 && start[0] == '\\' &&
+        start[1] == 'u') {
+        const char* next = start;
+        start += 2;
+        std::uint32_t low;
+        if (!hex(low))
+            return false;
+        if (low >= 0xDC00 && low <= 0xDFFF)
+            code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+        else
+            start = next;  // decoded as a separate escape
+    }
+    return true;
+}
+
+constexpr std::size_t JSON::utf8_encode(char* dst, std::uint32_t code) {
+    if (code < 0x80) {
+        dst[0] = static_cast<char>(code);
+        return 1;
+    }
+    if (code < 0x800) {
+        dst[0] = static_cast<char>(0xC0 | code >> 6);
+        dst[1] = static_cast<char>(0x80 | (code & 0x3F));
+        return 2;
+    }
+    if (code < 0x10000) {
+        dst[0] = static_cast<char>(0xE0 | code >> 12);
+        dst[1] = static_cast<char>(0x80 | (code >> 6 & 0x3F));
+        dst[2] = static_cast<char>(0x80 | (code & 0x3F));
+        return 3;
+    }
+    dst[0] = static_cast<char>(0xF0 | code >> 18);
+    dst[1] = static_cast<char>(0x80 | (code >> 12 & 0x3F));
+    dst[2] = static_cast<char>(0x80 | (code >> 6 & 0x3F));
+    dst[3] = static_cast<char>(0x80 | (code & 0x3F));
+    return 4;
+}
+
+// counts the values and the string characters before escapes, an object key is a value too
+consteval JSON::LiteralSize JSON::literal_size(std::string_view src) {
+    LiteralSize size;
+    for (std::size_t i = 0; i < src.size();) {
+        char c = src[i];
+        if (c == '"') {
+            ++size.nodes;
+            for (++i; i < src.size() && src[i] != '"'; ++i) {
+                i += src[i] == '\\';
+                ++size.chars;
+            }
+            ++i;
+        } else if (c == '/' && i + 1 < src.size() && src[i + 1] == '/') {
+            while (i < src.size() && src[i] != '\n')
+                ++i;
+        } else if (c == '{' || c == '[') {
+            ++size.nodes;
+            ++i;
+        } else if (c == '-' || (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z')) {
+            ++size.nodes;  // number, null, true or false
+            while (i < src.size() && (src[i] == '-' || src[i] == '+' || src[i] == '.' ||
+                                      (src[i] >= '0' && src[i] <= '9') ||
+                                      (src[i] >= 'a' && src[i] <= 'z') ||
+                                      (src[i] >= 'A' && src[i] <= 'Z')))
+                ++i;
+        } else {
+            ++i;
+        }
+    }
+    return size;
+}
+
+// document parsed at compile time, every value takes one node and string characters are
+// unescaped into a buffer, both sized by JSON::literal_size()
+template <std::size_t Nodes, std::size_t Chars>
+class JSON::Literal {
+   public:
+    consteval Literal(const char* src, std::size_t size) {
+        const char* start = src;
+        const char* end = src + size;
+        parse_value(start, end, 0);
+        skip_space(start, end);
+        if (start != end)
+            invalid_literal();
+    }
+
+    constexpr Static root() const { return {nodes_, chars_, 0}; }
+    constexpr Static operator[](std::size_t idx) const { return root()[idx]; }
+    constexpr Static operator[](std::string_view key) const { return root()[key]; }
+
+   private:
+    consteval void skip_space(const char*& start, const char* end) {
+        while (start < end) {
+            if (*start == ' ' || *start == '\n' || *start == '\r' || *start == '\t') {
+                ++start;
+            } else if (*start == '/' && start + 1 < end && start[1] == '/') {
+                while (start < end && *start != '\n')
+                    ++start;
+            } else {
+                break;
+            }
+        }
+    }
+
+    consteval bool skip_token(const char*& start, const char* end, std::string_view token) {
+        if (std::string_view{start, static_cast<std::size_t>(end - start)}.substr(
+                0, token.size()) != token)
+            return false;
+        start += token.size();
+        return true;
+    }
+
+    consteval void parse_value(const char*& start, const char* end, std::size_t depth) {
+        if (depth > JSON_MAX_DEPTH)
+            invalid_literal();
+        skip_space(start, end);
+        if (start == end)
+            invalid_literal();
+
+        if (count_ == Nodes)
+            invalid_literal();
+        std::uint32_t idx = count_++;
+        StaticNode& node = nodes_[idx];
+        switch (*start) {
+            case '{': {
+                node.type = TYPE_OBJECT;
+                ++start;
+                for (;;) {
+                    skip_space(start, end);
+                    if (start < end && *start == '}')
+                        break;
+                    if (start == end || *start != '"')
+                        invalid_literal();
+                    parse_value(start, end, depth + 1);
+                    skip_space(start, end);
+                    if (start == end || *start++ != ':')
+                        invalid_literal();
+                    parse_value(start, end, depth + 1);
+                    ++node.size;
+                    skip_space(start, end);
+                    if (start < end && *start == ',')
+                        ++start;
+                    else if (start == end || *start != '}')
+                        invalid_literal();
+                }
+                ++start;
+            } break;
+            case '[': {
+                node.type = TYPE_ARRAY;
+                ++start;
+                for (;;) {
+                    skip_space(start, end);
+                    if (start < end && *start == ']')
+                        break;
+                    parse_value(start, end, depth + 1);
+                    ++node.size;
+                    skip_space(start, end);
+                    if (start < end && *start == ',')
+                        ++start;
+                    else if (start == end || *start != ']')
+                        invalid_literal();
+                }
+                ++start;
+            } break;
+            case '"': {
+                node.type = TYPE_STRING;
+                node.offset = length_;
+                ++start;
+                for (;;) {
+                    if (start == end)
+                        invalid_literal();
+                    char c = *start++;
+                    if (c == '"')
+                        break;
+                    if (c == '\\') {
+                        if (start == end)
+                            invalid_literal();
+                        switch (*start++) {
+                            case '"':
+                            case '\\':
+                            case '/': {
+                                c = start[-1];
+                            } break;
+                            case 'b': {
+                                c = '\b';
+                            } break;
+                            case 'f': {
+                                c = '\f';
+                            } break;
+                            case 'n': {
+                                c = '\n';
+                            } break;
+                            case 'r': {
+                                c = '\r';
+                            } break;
+                            case 't': {
+                                c = '\t';
+                            } break;
+                            case 'u': {
+                                std::uint32_t code;
+                                if (!unescape(start, end, code))
+                                    invalid_literal();
+                                if (code >= 0xD800 && code <= 0xDFFF)
+                                    invalid_literal();  // unpaired surrogate
+                                length_ += utf8_encode(chars_ + length_, code);
+                                continue;
+                            }
+                            default:
+                                invalid_literal();
+                        }
+                    }
+                    chars_[length_++] = c;
+                }
+                node.size = length_ - node.offset;
+            } break;
+            default: {
+                if (skip_token(start, end, "null")) {
+                    node.type = TYPE_NULL;
+                } else if (skip_token(start, end, "true")) {
+                    node.type = TYPE_BOOL;
+                    node.as_bool = true;
+                } else if (skip_token(start, end, "false")) {
+                    node.type = TYPE_BOOL;
+                } else {
+                    parse_number(start, end, node);
+                }
+            } break;
+        }
+        node.next = count_;
+    }
+
+    consteval void parse_number(const char*& start, const char* end, StaticNode& node) {
+        bool negative = start < end && *start == '-';
+        start += negative;
+        if (start == end || *start < '0' || *start > '9' ||
+            (*start == '0' && start + 1 < end && start[1] >= '0' && start[1] <= '9'))
+            invalid_literal();
+
+        std::uint64_t mantissa = 0;
+        int digits = 0;
+        int exponent = 0;
+        bool integer = true;
+        bool dropped = false;  // nonzero digits past the 19 the mantissa holds
+        auto read_digits = [&](bool fraction) {
+            const char* first = start;
+            for (; start < end && *start >= '0' && *start <= '9'; ++start) {
+                if (digits < 19) {
+                    mantissa = mantissa * 10 + (*start - '0');
+                    digits += mantissa != 0;
+                    exponent -= fraction;
+                } else {
+                    exponent += !fraction;
+                    dropped = dropped || *start != '0';
+                }
+            }
+            if (start == first)
+                invalid_literal();
+        };
+
+        read_digits(false);
+        if (start < end && *start == '.') {
+            ++start;
+            integer = false;
+            read_digits(true);
+        }
+        if (start < end && (*start == 'e' || *start == 'E')) {
+            ++start;
+            integer = false;
+            bool negative_exponent = start < end && *start == '-';
+            start += start < end && (*start == '-' || *start == '+');
+            const char* first = start;
+            int value = 0;
+            for (; start < end && *start >= '0' && *start <= '9'; ++start)
+                value = value < 10000 ? value * 10 + (*start - '0') : value;
+            if (start == first)
+                invalid_literal();
+            exponent += negative_exponent ? -value : value;
+        }
+
+        if (integer) {
+            if (exponent != 0 || dropped ||
+                mantissa > static_cast<std::uint64_t>(INT64_MAX) + negative)
+                invalid_literal();  // doesn't fit into int64
+            node.type = TYPE_INT64;
+            node.as_int64 = negative ? static_cast<std::int64_t>(0 - mantissa)
+                                     : static_cast<std::int64_t>(mantissa);
+            return;
+        }
+
+        // the mantissa and 10^22 and below are exact doubles, so a single multiplication or
+        // division rounds correctly, like strtod, anything else fails the build
+        constexpr std::uint64_t exact = std::uint64_t{1} << 53;
+        while (mantissa != 0 && mantissa % 10 == 0 && (exponent < 0 || mantissa > exact)) {
+            mantissa /= 10;
+            ++exponent;
+        }
+        while (exponent > 22 && mantissa != 0 && mantissa <= exact / 10) {
+            mantissa *= 10;
+            --exponent;
+        }
+        if (mantissa == 0)
+            exponent = 0;
+        if (dropped || mantissa > exact || exponent > 22 || exponent < -22)
+            inexact_literal();
+        double scale = 1;
+        double base = 10;
+        for (int n = exponent < 0 ? -exponent : exponent; n > 0; n >>= 1) {
+            if (n & 1)
+                scale *= base;
+            base *= base;
+        }
+        double value = static_cast<double>(mantissa);
+        value = exponent < 0 ? value / scale : value * scale;
+        node.type = TYPE_DOUBLE;
+        node.as_double = negative ? -value : value;
+    }
+
+    StaticNode nodes_[Nodes > 0 ? Nodes : 1]{};
+    char chars_[Chars > 0 ? Chars : 1]{};
+    std::uint32_t count_ = 0;
+    std::uint32_t length_ = 0;
+};
+
+template <JSON::Source S>
+consteval auto JSON::literal() {
+    constexpr std::string_view src{S.chars, sizeof(S.chars) - 1};  // without the terminating null
+    constexpr LiteralSize size = literal_size(src);
+    return Literal<size.nodes, size.chars>{src.data(), src.size()};
+}
+
+#endif  // JSON_HPP
+
+#ifdef JSON_IMPLEMENTATION
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#ifdef JSON_STATS
+#include <chrono>
+#endif  // JSON_STATS
+
+static void hash_combine(std::size_t& seed, std::size_t hash);
+static std::size_t number_hash(double value);
+#ifdef JSON_RAW_NUMBERS
+static std::partial_ordering integer_compare(std::string_view a, std::string_view b);
+#endif  // JSON_RAW_NUMBERS
+template <class T>
+static T take(std::vector<T>& pool);
+static void pointer_escape(std::string& dst, std::string_view src);
+static std::size_t string_memory(const std::string& string);
+static bool number_valid(const char* start, const char* end);
+static void path_space(const char*& p, const char* end);
+static bool path_name(const char*& p, const char* end, std::string& name);
+static bool path_quoted(const char*& p, const char* end, std::string& string);
+static bool path_number(const char*& p, const char* end, std::int64_t& value);
+static bool pointer_index(const std::string& key, std::size_t size, std::size_t& idx);
+static const char* string_run(const char* start, const char* end);
+static const char* escape_run(const char* start, const char* end, bool ascii);
+static std::size_t utf8_length(const char* start, const char* end);
+#ifdef JSON_RAW_NUMBERS
+static const char* number_end(const char* start, const char* end);
+#endif  // JSON_RAW_NUMBERS
+#ifdef JSON_PACKED_ARRAYS
+template <class T>
+static void encode_numbers(std::string& dst, std::span<const T> values, bool pretty, int indent);
+#endif  // JSON_PACKED_ARRAYS
+#ifdef JSON_STATS
+static void stats_growth(JSON::Stats& stats, std::size_t size, std::size_t capacity, std::size_t n);
+static void stats_string(JSON::Stats& stats, const std::string& string);
+#endif  // JSON_STATS
+
+const char* JSON::status_string(Status status) {
+    switch (status) {
+        case SUCCESS:
+            return "SUCCESS";
+        case END:
+            return "END";
+        case DEPTH_EXCEEDED:
+            return "DEPTH_EXCEEDED";
+        case INVALID_KEY_TYPE:
+            return "INVALID_KEY_TYPE";
+        case INVALID_STRING_ESCAPE:
+            return "INVALID_STRING_ESCAPE";
+        case INVALID_TOKEN:
+            return "INVALID_TOKEN";
+        case UNEXPECTED_STRING_END:
+            return "UNEXPECTED_STRING_END";
+#ifdef JSON_STRICT
+        case INVALID_NUMBER:
+            return "INVALID_NUMBER";
+        case TRAILING_CONTENT:
+            return "TRAILING_CONTENT";
+        case UNEXPECTED_ARRAY:
+            return "UNEXPECTED_ARRAY";
+        case UNEXPECTED_ARRAY_END:
+            return "UNEXPECTED_ARRAY_END";
+        case UNEXPECTED_COLON:
+            return "UNEXPECTED_COLON";
+        case UNEXPECTED_COMMA:
+            return "UNEXPECTED_COMMA";
+        case UNEXPECTED_END:
+            return "UNEXPECTED_END";
+        case UNEXPECTED_NUMBER:
+            return "UNEXPECTED_NUMBER";
+        case UNEXPECTED_OBJECT:
+            return "UNEXPECTED_OBJECT";
+        case UNEXPECTED_OBJECT_END:
+            return "UNEXPECTED_OBJECT_END";
+        case UNEXPECTED_STRING:
+            return "UNEXPECTED_STRING";
+        case UNEXPECTED_TOKEN:
+            return "UNEXPECTED_TOKEN";
+#endif  // JSON_STRICT
+        case INVALID_PATCH:
+            return "INVALID_PATCH";
+        case INVALID_POINTER:
+            return "INVALID_POINTER";
+        case PATH_NOT_FOUND:
+            return "PATH_NOT_FOUND";
+        case TEST_FAILED:
+            return "TEST_FAILED";
+        case TYPE_MISMATCH:
+            return "TYPE_MISMATCH";
+        case INVALID_SCHEMA:
+            return "INVALID_SCHEMA";
+        case SCHEMA_ENUM:
+            return "SCHEMA_ENUM";
+        case SCHEMA_RANGE:
+            return "SCHEMA_RANGE";
+        case SCHEMA_REQUIRED:
+            return "SCHEMA_REQUIRED";
+        case SCHEMA_TYPE:
+            return "SCHEMA_TYPE";
+        case INVALID_PATH:
+            return "INVALID_PATH";
+        case BYTES_EXCEEDED:
+            return "BYTES_EXCEEDED";
+        case NODES_EXCEEDED:
+            return "NODES_EXCEEDED";
+        case STRING_LENGTH_EXCEEDED:
+            return "STRING_LENGTH_EXCEEDED";
+        case ELEMENTS_EXCEEDED:
+            return "ELEMENTS_EXCEEDED";
+#ifdef JSON_VALIDATE_UTF8
+        case INVALID_UTF8:
+            return "INVALID_UTF8";
+#endif  // JSON_VALIDATE_UTF8
+        default:
+            assert(false);
+            return "UNKNOWN_STATUS";
+    }
+}
+
+JSON JSON::array(const std::vector<JSON>& array) {
+    JSON json;
+    json.init_array();
+    json.elements() = array;
+    return json;
+}
+
+JSON JSON::array(std::vector<JSON>&& array) {
+    JSON json;
+    json.init_array();
+    json.elements() = std::move(array);
+    return json;
+}
+
+JSON JSON::object(const std::map<std::string, JSON, std::less<>>& object) {
+    JSON json;
+    json.init_object();
+    json.members() = object;
+    return json;
+}
+
+JSON JSON::object(std::map<std::string, JSON, std::less<>>&& object) {
+    JSON json;
+    json.init_object();
+    json.members() = std::move(object);
+    return json;
+}
+
+JSON::JSON(const std::nullptr_t) : type_{TYPE_NULL} {}
+JSON::JSON(bool value) : type_{TYPE_BOOL}, as_bool_{value} {}
+JSON::JSON(int value) : type_{TYPE_INT64}, as_int64_{value} {}
+JSON::JSON(std::int64_t value) : type_{TYPE_INT64}, as_int64_{value} {}
+#ifdef JSON_RAW_NUMBERS
+JSON::JSON(std::uint64_t value) : type_{TYPE_INT64} {
+    if (value <= static_cast<std::uint64_t>(INT64_MAX)) {
+        as_int64_ = static_cast<std::int64_t>(value);
+    } else {
+        new (&as_raw_) Raw{std::to_string(value)};
+        raw_ = true;
+    }
+}
+#else   // JSON_RAW_NUMBERS
+JSON::JSON(std::uint64_t value) : type_{TYPE_INT64}, as_int64_{static_cast<std::int64_t>(value)} {
+    if (value > static_cast<std::uint64_t>(INT64_MAX)) {
+        type_ = TYPE_DOUBLE;  // doesn't fit into int64
+        as_double_ = static_cast<double>(value);
+    }
+}
+#endif  // JSON_RAW_NUMBERS
+JSON::JSON(float value) : type_{TYPE_DOUBLE}, as_double_{value} {}
+JSON::JSON(double value) : type_{TYPE_DOUBLE}, as_double_{value} {}
+JSON::JSON(const char* value) : type_{TYPE_STRING}, as_string_{value} {}
+JSON::JSON(std::string&& value) : type_{TYPE_STRING}, as_string_{std::move(value)} {}
+JSON::JSON(const std::string& value) : type_{TYPE_STRING}, as_string_{std::move(value)} {}
+
+JSON::~JSON() {
+    clear();
+}
+
+JSON::JSON(const JSON& other) : type_{other.type_} {
+#ifdef JSON_RAW_NUMBERS
+    if (other.raw_) {
+        new (&as_raw_) Raw{other.as_raw_.text};
+        raw_ = true;
+        return;
+    }
+#endif  // JSON_RAW_NUMBERS
+#ifdef JSON_PACKED_ARRAYS
+    if (other.packed_) {
+#ifdef JSON_COW
+        as_packed_ = other.as_packed_;
+        as_packed_->refs.fetch_add(1, std::memory_order_relaxed);
+#else   // JSON_COW
+        const Packed& packed = *other.as_packed_;
+        as_packed_ = new Packed{packed.type, packed.int64s, packed.doubles};
+#endif  // JSON_COW
+        packed_ = true;
+        return;
+    }
+#endif  // JSON_PACKED_ARRAYS
+    switch (type_) {
+        case TYPE_NULL:
+            break;
+        case TYPE_BOOL: {
+            as_bool_ = other.as_bool_;
+        } break;
+        case TYPE_INT64: {
+            as_int64_ = other.as_int64_;
+        } break;
+        case TYPE_DOUBLE: {
+            as_double_ = other.as_double_;
+        } break;
+        case TYPE_STRING: {
+            new (&as_string_) std::string{other.as_string_};
+        } break;
+        case TYPE_ARRAY: {
+#ifdef JSON_COW
+            as_array_ = other.as_array_;
+            as_array_->refs.fetch_add(1, std::memory_order_relaxed);
+#else   // JSON_COW
+            new (&as_array_) std::vector{other.as_array_};
+#endif  // JSON_COW
+        } break;
+        case TYPE_OBJECT: {
+#ifdef JSON_COW
+            as_object_ = other.as_object_;
+            as_object_->refs.fetch_add(1, std::memory_order_relaxed);
+#else   // JSON_COW
+            new (&as_object_) std::map{other.as_object_};
+#endif  // JSON_COW
+        } break;
+        default:
+            assert(false);
+    }
+}
+
+JSON& JSON::operator=(const JSON& other) {
+    if (this != &other) {
+        clear();
+        type_ = other.type_;
+#ifdef JSON_RAW_NUMBERS
+        if (other.raw_) {
+            new (&as_raw_) Raw{other.as_raw_.text};
+            raw_ = true;
+            return *this;
+        }
+#endif  // JSON_RAW_NUMBERS
+#ifdef JSON_PACKED_ARRAYS
+        if (other.packed_) {
+#ifdef JSON_COW
+            as_packed_ = other.as_packed_;
+            as_packed_->refs.fetch_add(1, std::memory_order_relaxed);
+#else   // JSON_COW
+            const Packed& packed = *other.as_packed_;
+            as_packed_ = new Packed{packed.type, packed.int64s, packed.doubles};
+#endif  // JSON_COW
+            packed_ = true;
+            return *this;
+        }
+#endif  // JSON_PACKED_ARRAYS
+
+        switch (type_) {
+            case TYPE_NULL:
+                break;
+            case TYPE_BOOL: {
+                as_bool_ = other.as_bool_;
+            } break;
+            case TYPE_INT64: {
+                as_int64_ = other.as_int64_;
+            } break;
+            case TYPE_DOUBLE: {
+                as_double_ = other.as_double_;
+            } break;
+            case TYPE_STRING: {
+                new (&as_string_) std::string{other.as_string_};
+            } break;
+            case TYPE_ARRAY: {
+#ifdef JSON_COW
+                as_array_ = other.as_array_;
+                as_array_->refs.fetch_add(1, std::memory_order_relaxed);
+#else   // JSON_COW
+                new (&as_array_) std::vector{other.as_array_};
+#endif  // JSON_COW
+            } break;
+            case TYPE_OBJECT: {
+#ifdef JSON_COW
+                as_object_ = other.as_object_;
+                as_object_->refs.fetch_add(1, std::memory_order_relaxed);
+#else   // JSON_COW
+                new (&as_object_) std::map{other.as_object_};
+#endif  // JSON_COW
+            } break;
+            default:
+                assert(false);
+        }
+    }
+
+    return *this;
+}
+
+JSON::JSON(JSON&& other) noexcept : type_{other.type_} {
+    other.type_ = TYPE_NULL;
+#ifdef JSON_RAW_NUMBERS
+    if (other.raw_) {
+        new (&as_raw_) Raw{std::move(other.as_raw_.text)};
+        raw_ = true;
+        other.raw_ = false;
+        return;
+    }
+#endif  // JSON_RAW_NUMBERS
+#ifdef JSON_PACKED_ARRAYS
+    if (other.packed_) {
+        as_packed_ = other.as_packed_;
+        packed_ = true;
+        other.packed_ = false;
+        return;
+    }
+#endif  // JSON_PACKED_ARRAYS
+
+    switch (type_) {
+        case TYPE_NULL:
+            break;
+        case TYPE_BOOL: {
+            as_bool_ = other.as_bool_;
+        } break;
+        case TYPE_INT64: {
+            as_int64_ = other.as_int64_;
+        } break;
+        case TYPE_DOUBLE: {
+            as_double_ = other.as_double_;
+        } break;
+        case TYPE_STRING: {
+            new (&as_string_) std::string{std::move(other.as_string_)};
+        } break;
+        case TYPE_ARRAY: {
+#ifdef JSON_COW
+            as_array_ = other.as_array_;
+#else   // JSON_COW
+            new (&as_array_) std::vector{std::move(other.as_array_)};
+#endif  // JSON_COW
+        } break;
+        case TYPE_OBJECT: {
+#ifdef JSON_COW
+            as_object_ = other.as_object_;
+#else   // JSON_COW
+            new (&as_object_) std::map{std::move(other.as_object_)};
+#endif  // JSON_COW
+        } break;
+        default:
+            assert(false);
+    }
+}
+
+JSON& JSON::operator=(JSON&& other) noexcept {
+    if (this != &other) {
+        clear();
         type_ = other.type_;
         other.type_ = TYPE_NULL;
+#ifdef JSON_RAW_NUMBERS
+        if (other.raw_) {
+            new (&as_raw_) Raw{std::move(other.as_raw_.text)};
+            raw_ = true;
+            other.raw_ = false;
+            return *this;
+        }
+#endif  // JSON_RAW_NUMBERS
+#ifdef JSON_PACKED_ARRAYS
+        if (other.packed_) {
+            as_packed_ = other.as_packed_;
+            packed_ = true;
+            other.packed_ = false;
+            return *this;
+        }
+#endif  // JSON_PACKED_ARRAYS
+
+        switch (type_) {
+            case TYPE_NULL:
+                break;
+            case TYPE_BOOL: {
+                as_bool_ = other.as_bool_;
+            } break;
+            case TYPE_INT64: {
+                as_int64_ = other.as_int64_;
+            } break;
+            case TYPE_DOUBLE: {
+                as_double_ = other.as_double_;
+            } break;
+            case TYPE_STRING: {
+                new (&as_string_) std::string{std::move(other.as_string_)};
+            } break;
+            case TYPE_ARRAY: {
+#ifdef JSON_COW
+                as_array_ = other.as_array_;
+#else   // JSON_COW
+                new (&as_array_) std::vector{std::move(other.as_array_)};
+#endif  // JSON_COW
+            } break;
+            case TYPE_OBJECT: {
+#ifdef JSON_COW
+                as_object_ = other.as_object_;
+#else   // JSON_COW
+                new (&as_object_) std::map{std::move(other.as_object_)};
+#endif  // JSON_COW
+            } break;
+            default:
+                assert(false);
+        }
+    }
+
+    return *this;
+}
+
+JSON::Type JSON::type() const {
+    return type_;
+}
+
+bool JSON::is_null() const {
+    return type_ == TYPE_NULL;
+}
+
+bool JSON::is_bool() const {
+    return type_ == TYPE_BOOL;
+}
+
+bool JSON::is_int64() const {
+    return type_ == TYPE_INT64;
+}
+
+bool JSON::is_double() const {
+    return type_ == TYPE_DOUBLE;
+}
+
+bool JSON::is_string() const {
+    return type_ == TYPE_STRING;
+}
+
+bool JSON::is_array() const {
+    return type_ == TYPE_ARRAY;
+}
+
+bool JSON::is_object() const {
+    return type_ == TYPE_OBJECT;
+}
+
+bool JSON::get_bool(bool fallback) const {
+    switch (type_) {
+        case TYPE_BOOL:
+            return as_bool_;
+        default:
+            return fallback;
+    }
+}
+
+std::int64_t JSON::get_int64(std::int64_t fallback) const {
+    switch (type_) {
+        case TYPE_INT64:
+            return int64_value();
+        case TYPE_DOUBLE:
+            return double_value();
+        default:
+            return fallback;
+    }
+}
+
+std::uint64_t JSON::get_uint64(std::uint64_t fallback) const {
+    switch (type_) {
+        case TYPE_INT64: {
+#ifdef JSON_RAW_NUMBERS
+            if (raw_) {  // might not fit into int64
+                const std::string& text = as_raw_.text;
+                std::uint64_t value;
+                std::from_chars_result result =
+                    std::from_chars(text.data(), text.data() + text.size(), value);
+                return result.ec == std::errc{} ? value : fallback;
+            }
+#endif  // JSON_RAW_NUMBERS
+            std::int64_t value = int64_value();
+            return value >= 0 ? static_cast<std::uint64_t>(value) : fallback;
+        }
+        case TYPE_DOUBLE: {
+            double value = double_value();
+            return value >= 0 && value < 0x1p64 ? static_cast<std::uint64_t>(value) : fallback;
+        }
+        default:
+            return fallback;
+    }
+}
+
+double JSON::get_double(double fallback) const {
+    switch (type_) {
+        case TYPE_INT64:
+            return int64_value();
+        case TYPE_DOUBLE:
+            return double_value();
+        default:
+            return fallback;
+    }
+}
+
+std::string& JSON::get_string(const std::string& fallback) {
+    if (type_ != TYPE_STRING) {
+        init_string();
+        as_string_ = fallback;
+    }
+
+    return as_string_;
+}
+
+std::string& JSON::get_string(std::string&& fallback) {
+    if (type_ != TYPE_STRING) {
+        init_string();
+        as_string_ = std::move(fallback);
+    }
+
+    return as_string_;
+}
+
+std::vector<JSON>& JSON::get_array(const std::vector<JSON>& fallback) {
+    if (type_ != TYPE_ARRAY) {
+        init_array();
+        elements() = fallback;
+    }
+
+    return elements();
+}
+
+std::vector<JSON>& JSON::get_array(std::vector<JSON>&& fallback) {
+    if (type_ != TYPE_ARRAY) {
+        init_array();
+        elements() = std::move(fallback);
+    }
+
+    return elements();
+}
+
+std::map<std::string, JSON, std::less<>>& JSON::get_object(
+    const std::map<std::string, JSON, std::less<>>& fallback) {
+    if (type_ != TYPE_OBJECT) {
+        init_object();
+        members() = fallback;
+    }
+
+    return members();
+}
+
+std::map<std::string, JSON, std::less<>>& JSON::get_object(
+    std::map<std::string, JSON, std::less<>>&& fallback) {
+    if (type_ != TYPE_OBJECT) {
+        init_object();
+        members() = std::move(fallback);
+    }
+
+    return members();
+}
+
+const std::string& JSON::get_string() const {
+    static const std::string empty;
+    return type_ == TYPE_STRING ? as_string_ : empty;
+}
+
+const std::vector<JSON>& JSON::get_array() const {
+    static const std::vector<JSON> empty;
+    return type_ == TYPE_ARRAY ? elements() : empty;
+}
+
+const std::map<std::string, JSON, std::less<>>& JSON::get_object() const {
+    static const std::map<std::string, JSON, std::less<>> empty;
+    return type_ == TYPE_OBJECT ? members() : empty;
+}
+
+#ifdef JSON_PACKED_ARRAYS
+std::span<const std::int64_t> JSON::get_int64s() const {
+    if (!packed_)
+        return {};
+    return as_packed_->int64s;
+}
+
+std::span<const double> JSON::get_doubles() const {
+    if (!packed_)
+        return {};
+    return as_packed_->doubles;
+}
+#endif  // JSON_PACKED_ARRAYS
+
+JSON& JSON::operator[](std::size_t idx) {
+    if (type_ != TYPE_ARRAY)
+        init_array();
+    std::vector<JSON>& array = elements();
+    if (idx >= array.size())
+        array.resize(idx + 1);
+    return array[idx];
+}
+
+JSON& JSON::operator[](std::string_view key) {
+    if (type_ != TYPE_OBJECT)
+        init_object();
+    std::map<std::string, JSON, std::less<>>& object = members();
+    auto it = object.lower_bound(key);
+    if (it == object.end() || it->first != key)
+        it = object.emplace_hint(it, key, nullptr);
+    return it->second;
+}
+
+const JSON& JSON::operator[](std::size_t idx) const {
+    static const JSON null;
+    if (type_ != TYPE_ARRAY || idx >= elements().size())
+        return null;
+    return elements()[idx];
+}
+
+const JSON& JSON::operator[](std::string_view key) const {
+    static const JSON null;
+    const JSON* json = find(key);
+    return json != nullptr ? *json : null;
+}
+
+JSON* JSON::find(std::string_view key) {
+    if (type_ != TYPE_OBJECT)
+        return nullptr;
+    auto& object = members();
+    auto it = object.find(key);
+    return it != object.end() ? &it->second : nullptr;
+}
+
+const JSON* JSON::find(std::string_view key) const {
+    if (type_ != TYPE_OBJECT)
+        return nullptr;
+    auto& object = members();
+    auto it = object.find(key);
+    return it != object.end() ? &it->second : nullptr;
+}
+
+std::size_t JSON::size() const {
+    switch (type_) {
+        case TYPE_STRING:
+            return as_string_.size();
+        case TYPE_ARRAY:
+#ifdef JSON_PACKED_ARRAYS
+            if (packed_)
+                return as_packed_->int64s.size() + as_packed_->doubles.size();
+#endif  // JSON_PACKED_ARRAYS
+            return elements().size();
+        case TYPE_OBJECT:
+            return members().size();
+        default:
+            return 0;
+    }
+}
+
+bool JSON::empty() const {
+    return size() == 0;
+}
+
+bool JSON::has(std::string_view key) const {
+    return find(key) != nullptr;
+}
+
+void JSON::reserve(std::size_t capacity) {
+    get_array().reserve(capacity);
+}
+
+void JSON::push_back(JSON value) {
+    get_array().push_back(std::move(value));
+}
+
+std::string JSON::take_string() {
+    std::string string;
+    if (type_ == TYPE_STRING)
+        string = std::move(as_string_);
+    clear();
+    type_ = TYPE_NULL;
+    return string;
+}
+
+std::vector<JSON> JSON::take_array() {
+    std::vector<JSON> array;
+    if (type_ == TYPE_ARRAY)
+        array = std::move(elements());  // storage shared with copies is copied first
+    clear();
+    type_ = TYPE_NULL;
+    return array;
+}
+
+std::map<std::string, JSON, std::less<>> JSON::take_object() {
+    std::map<std::string, JSON, std::less<>> object;
+    if (type_ == TYPE_OBJECT)
+        object = std::move(members());
+    clear();
+    type_ = TYPE_NULL;
+    return object;
+}
+
+// calls f with the element at idx, a packed value is passed as a temporary instead of expanding
+// the whole array into nodes
+template <class F>
+decltype(auto) JSON::with_element(std::size_t idx, F&& f) const {
+#ifdef JSON_PACKED_ARRAYS
+    if (packed_) {
+        if (as_packed_->type == TYPE_INT64)
+            return f(JSON{as_packed_->int64s[idx]});
+        return f(JSON{as_packed_->doubles[idx]});
+    }
+#endif  // JSON_PACKED_ARRAYS
+    return f(elements()[idx]);
+}
+
+bool JSON::operator==(const JSON& other) const {
+    if (shares(other))
+        return true;
+#ifdef JSON_HASH_CACHE
+    std::size_t h1 = hash_.load(std::memory_order_relaxed);
+    std::size_t h2 = other.hash_.load(std::memory_order_relaxed);
+    if (h1 != 0 && h2 != 0 && h1 != h2)
+        return false;
+#endif  // JSON_HASH_CACHE
+
+    switch (type_) {
+        case TYPE_NULL:
+            return other.type_ == TYPE_NULL;
+        case TYPE_BOOL:
+            return other.type_ == TYPE_BOOL && as_bool_ == other.as_bool_;
+        case TYPE_INT64:
+            if (other.type_ == TYPE_INT64)
+                return compare_integer(other) == 0;
+            return other.type_ == TYPE_DOUBLE && compare_double(other.double_value()) == 0;
+        case TYPE_DOUBLE:
+            if (other.type_ == TYPE_DOUBLE)
+                return double_value() == other.double_value();
+            return other.type_ == TYPE_INT64 && other.compare_double(double_value()) == 0;
+        case TYPE_STRING:
+            return other.type_ == TYPE_STRING && as_string_ == other.as_string_;
+        case TYPE_ARRAY: {
+            if (other.type_ != TYPE_ARRAY || size() != other.size())
+                return false;
+#ifdef JSON_PACKED_ARRAYS
+            if (packed_ && other.packed_ && as_packed_->type == other.as_packed_->type)
+                return as_packed_->int64s == other.as_packed_->int64s &&
+                       as_packed_->doubles == other.as_packed_->doubles;
+#endif  // JSON_PACKED_ARRAYS
+            for (std::size_t i = 0; i < size(); ++i) {
+                bool equal = with_element(i, [&](const JSON& a) {
+                    return other.with_element(i, [&](const JSON& b) { return a == b; });
+                });
+                if (!equal)
+                    return false;
+            }
+            return true;
+        }
+        case TYPE_OBJECT: {
+            if (other.type_ != TYPE_OBJECT || members().size() != other.members().size())
+                return false;
+            const std::map<std::string, JSON, std::less<>>& a = members();
+            const std::map<std::string, JSON, std::less<>>& b = other.members();
+            for (auto it1 = a.begin(), it2 = b.begin(); it1 != a.end(); ++it1, ++it2) {
+                if (it1->first != it2->first || it1->second != it2->second)
+                    return false;
+            }
+            return true;
+        }
+        default:
+            assert(false);
+            return false;
+    }
+}
+
+std::partial_ordering JSON::operator<=>(const JSON& other) const {
+    // int64 and double share a rank and compare by value, like operator==
+    static const int RANKS[] = {0, 1, 2, 2, 3, 4, 5};
+    if (shares(other))
+        return std::partial_ordering::equivalent;
+    if (RANKS[type_] != RANKS[other.type_])
+        return RANKS[type_] <=> RANKS[other.type_];
+
+    switch (type_) {
+        case TYPE_NULL:
+            return std::partial_ordering::equivalent;
+        case TYPE_BOOL:
+            return as_bool_ <=> other.as_bool_;
+        case TYPE_INT64:
+            if (other.type_ == TYPE_INT64)
+                return compare_integer(other);
+            return compare_double(other.double_value());
+        case TYPE_DOUBLE:
+            if (other.type_ == TYPE_DOUBLE)
+                return double_value() <=> other.double_value();
+            return 0 <=> other.compare_double(double_value());
+        case TYPE_STRING:
+            return as_string_.compare(other.as_string_) <=> 0;
+        case TYPE_ARRAY: {
+            for (std::size_t i = 0; i < size() && i < other.size(); ++i) {
+                std::partial_ordering cmp = with_element(i, [&](const JSON& a) {
+                    return other.with_element(i, [&](const JSON& b) { return a <=> b; });
+                });
+                if (cmp != 0)
+                    return cmp;
+            }
+            return size() <=> other.size();
+        }
+        case TYPE_OBJECT: {
+            const std::map<std::string, JSON, std::less<>>& a = members();
+            const std::map<std::string, JSON, std::less<>>& b = other.members();
+            for (auto it1 = a.begin(), it2 = b.begin(); it1 != a.end() && it2 != b.end();
+                 ++it1, ++it2) {
+                if (int cmp = it1->first.compare(it2->first); cmp != 0)
+                    return cmp <=> 0;
+                std::partial_ordering cmp = it1->second <=> it2->second;
+                if (cmp != 0)
+                    return cmp;
+            }
+            return a.size() <=> b.size();
+        }
+        default:
+            assert(false);
+            return std::partial_ordering::unordered;
+    }
+}
+
+std::size_t JSON::hash() const {
+    return hash(false);
+}
+
+// hashes are memoized only by freeze(), a mutable document can be changed through a reference
+// to a child, which would leave the hashes of its parents stale
+std::size_t JSON::hash([[maybe_unused]] bool memoize) const {
+    switch (type_) {
+        case TYPE_NULL:
+            return 0;
+        case TYPE_BOOL:
+            return as_bool_ ? 1 : 2;
+        case TYPE_INT64:
+#ifdef JSON_RAW_NUMBERS
+            if (overflows()) {  // like a double only if one is exactly equal to it
+                double value = std::strtod(as_raw_.text.c_str(), nullptr);
+                if (compare_double(value) == 0)
+                    return number_hash(value);
+                return std::hash<std::string>{}(as_raw_.text);
+            }
+#endif  // JSON_RAW_NUMBERS
+            return std::hash<std::int64_t>{}(int64_value());
+        case TYPE_DOUBLE:
+            return number_hash(double_value());
+        case TYPE_STRING:
+            return std::hash<std::string>{}(as_string_);
+        default:
+            break;
+    }
+
+#ifdef JSON_HASH_CACHE
+    std::size_t cached = hash_.load(std::memory_order_relaxed);
+    if (cached != 0)
+        return cached;
+#endif  // JSON_HASH_CACHE
+
+    std::size_t seed = size();
+    if (type_ == TYPE_ARRAY) {
+        each_element([&](const JSON& value) { hash_combine(seed, value.hash(memoize)); });
+    } else {
+        for (const auto& [key, value] : members()) {
+            hash_combine(seed, std::hash<std::string>{}(key));
+            hash_combine(seed, value.hash(memoize));
+        }
+    }
+
+#ifdef JSON_HASH_CACHE
+    seed = seed != 0 ? seed : 1;
+    if (memoize)
+        hash_.store(seed, std::memory_order_relaxed);
+#endif  // JSON_HASH_CACHE
+    return seed;
+}
+
+void JSON::clear() {
+#ifdef JSON_HASH_CACHE
+    hash_.store(0, std::memory_order_relaxed);
+#endif  // JSON_HASH_CACHE
+#ifdef JSON_RAW_NUMBERS
+    if (raw_) {
+        as_raw_.~Raw();
+        raw_ = false;
+    }
+#endif  // JSON_RAW_NUMBERS
+#ifdef JSON_PACKED_ARRAYS
+    if (packed_) {
+        release(as_packed_);
+        packed_ = false;
+        return;
+    }
+#endif  // JSON_PACKED_ARRAYS
+    switch (type_) {
+        case TYPE_STRING: {
+            as_string_.~basic_string();
+        } break;
+        case TYPE_ARRAY: {
+#ifdef JSON_COW
+            release(as_array_);
+#else   // JSON_COW
+            as_array_.~vector();
+#endif  // JSON_COW
+        } break;
+        case TYPE_OBJECT: {
+#ifdef JSON_COW
+            release(as_object_);
+#else   // JSON_COW
+            as_object_.~map();
+#endif  // JSON_COW
+        } break;
+        default:
+            break;
+    }
+}
+
+JSON::Memory JSON::memory_usage() const {
+    Memory memory;
+    std::unordered_set<const void*> seen;
+    measure(memory, seen);
+    return memory;
+}
+
+void JSON::shrink_to_fit() {
+#ifdef JSON_RAW_NUMBERS
+    if (raw_) {
+        as_raw_.text.shrink_to_fit();
+        return;
+    }
+#endif  // JSON_RAW_NUMBERS
+#ifdef JSON_PACKED_ARRAYS
+    if (packed_) {
+#ifdef JSON_COW
+        if (as_packed_->refs.load(std::memory_order_acquire) != 1)
+            return;  // still read by a copy
+#endif  // JSON_COW
+        as_packed_->int64s.shrink_to_fit();
+        as_packed_->doubles.shrink_to_fit();
+        return;
+    }
+#endif  // JSON_PACKED_ARRAYS
+
+    switch (type_) {
+        case TYPE_STRING: {
+            as_string_.shrink_to_fit();
+        } break;
+        case TYPE_ARRAY: {
+#ifdef JSON_COW
+            if (as_array_->refs.load(std::memory_order_acquire) != 1)
+                break;  // writing to it would copy it
+#endif  // JSON_COW
+            std::vector<JSON>& array = elements();
+            array.shrink_to_fit();
+            for (JSON& value : array)
+                value.shrink_to_fit();
+        } break;
+        case TYPE_OBJECT: {
+#ifdef JSON_COW
+            if (as_object_->refs.load(std::memory_order_acquire) != 1)
+                break;
+#endif  // JSON_COW
+            std::map<std::string, JSON, std::less<>>& object = members();
+            for (auto it = object.begin(); it != object.end();) {
+                it->second.shrink_to_fit();
+                if (string_memory(it->first) <= it->first.size() + 1) {
+                    ++it;
+                    continue;
+                }
+                auto node = object.extract(it++);  // keys are const in the map
+                node.key().shrink_to_fit();
+                object.insert(it, std::move(node));
+            }
+        } break;
+        default:
+            break;
+    }
+}
+
+void JSON::measure(Memory& memory, std::unordered_set<const void*>& seen) const {
+#ifdef JSON_RAW_NUMBERS
+    if (raw_) {
+        memory.strings += string_memory(as_raw_.text);
+        return;
+    }
+#endif  // JSON_RAW_NUMBERS
+#ifdef JSON_PACKED_ARRAYS
+    if (packed_) {
+#ifdef JSON_COW
+        if (!seen.insert(as_packed_).second)
+            return;
+#endif  // JSON_COW
+        const Packed& packed = *as_packed_;
+        memory.arrays += sizeof(Packed) + packed.int64s.capacity() * sizeof(std::int64_t) +
+                         packed.doubles.capacity() * sizeof(double);
+        if (const std::vector<JSON>* nodes = packed.nodes.load(std::memory_order_acquire))
+            memory.arrays += sizeof(*nodes) + nodes->capacity() * sizeof(JSON);
+        return;
+    }
+#endif  // JSON_PACKED_ARRAYS
+
+    switch (type_) {
+        case TYPE_STRING: {
+            memory.strings += string_memory(as_string_);
+        } break;
+        case TYPE_ARRAY: {
+#ifdef JSON_COW
+            if (!seen.insert(as_array_).second)
+                break;
+            memory.arrays += sizeof(*as_array_);
+#endif  // JSON_COW
+            const std::vector<JSON>& array = elements();
+            memory.arrays += array.capacity() * sizeof(JSON);
+            for (const JSON& value : array)
+                value.measure(memory, seen);
+        } break;
+        case TYPE_OBJECT: {
+#ifdef JSON_COW
+            if (!seen.insert(as_object_).second)
+                break;
+            memory.objects += sizeof(*as_object_);
+#endif  // JSON_COW
+            // a tree node per member, the header is a color and three pointers
+            std::size_t node = sizeof(std::pair<const std::string, JSON>) + 4 * sizeof(void*);
+            for (const auto& [key, value] : members()) {
+                memory.objects += node;
+                memory.strings += string_memory(key);
+                value.measure(memory, seen);
+            }
+        } break;
+        default:
+            break;
+    }
+}
+
+bool JSON::parse(const std::string& src, Status* status) {
+    Decoder decoder;
+    Status s1 = decode(src, nullptr, nullptr, decoder);
+    if (status != nullptr)
+        *status = s1;
+    return s1 == SUCCESS;
+}
+
+bool JSON::parse(const std::string& src, const JSON& projection, Status* status) {
+    const JSON* selected = project(projection);
+    Decoder decoder;
+    Status s1 = decode(src, selected, nullptr, decoder);
+    if (selected == &SKIP)
+        *this = nullptr;  // validated, but nothing is kept
+    if (status != nullptr)
+        *status = s1;
+    return s1 == SUCCESS;
+}
+
+bool JSON::parse(const std::string& src, const Limits& limits, Status* status) {
+    Decoder decoder;
+    decoder.limits = &limits;
+    decoder.nodes = 1;  // the root, the others are charged when they're added
+    Status s1 = decode(src, nullptr, nullptr, decoder);
+    if (status != nullptr)
+        *status = s1;
+    return s1 == SUCCESS;
+}
+
+bool JSON::parse(const std::string& src, const Schema& schema, Status* status, std::string* path) {
+    Decoder decoder;
+    decoder.path = path;
+    if (path != nullptr)
+        path->clear();
+    Status s1 = decode(src, nullptr, schema.root_, decoder);
+    if (status != nullptr)
+        *status = s1;
+    return s1 == SUCCESS;
+}
 
-        switch (type_) {
-            case TYPE_NULL:
+bool JSON::Parser::parse(JSON& json, const std::string& src, Status* status) {
+    Decoder decoder;
+    decoder.scratch = &scratch_;
+    Status s1 = json.decode(src, nullptr, nullptr, decoder);
+    if (status != nullptr)
+        *status = s1;
+    return s1 == SUCCESS;
+}
+
+void JSON::Parser::clear() {
+    scratch_ = {};
+}
+
+std::string JSON::dump(bool pretty, bool ascii) const {
+#ifdef JSON_STATS
+    auto started = std::chrono::steady_clock::now();
+#endif  // JSON_STATS
+    std::string string;
+    encode(string, pretty, 1, ascii);
+#ifdef JSON_STATS
+    if (stats_callback()) {
+        Stats stats;
+        stats.phase = Stats::DUMP;
+        stats.ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now() - started)
+                       .count();
+        collect(stats, 0);
+        stats.allocations = 0;  // dump only allocates the result
+        stats.allocated_bytes = 0;
+        stats_growth(stats, string.size(), std::string().capacity(), 1);
+        stats.bytes = string.size();
+        stats_callback()(stats);
+    }
+#endif  // JSON_STATS
+    return string;
+}
+
+bool JSON::patch(JSON patch, Status* status) {
+    Status s = patch.is_array() ? SUCCESS : INVALID_PATCH;
+    if (s == SUCCESS) {
+        // ops are applied in place, the values they remove or overwrite are moved to the log,
+        // so that a failed op can put the document back as it was without copying it upfront
+        std::vector<Undo> undo;
+        for (JSON& op : patch.elements()) {
+            s = apply(op, undo);
+            if (s != SUCCESS)
                 break;
+        }
+        if (s != SUCCESS)
+            rollback(undo);
+    }
+    if (status != nullptr)
+        *status = s;
+    return s == SUCCESS;
+}
+
+void JSON::merge_patch(JSON patch) {
+    if (!patch.is_object()) {
+        *this = std::move(patch);
+        return;
+    }
+
+    if (type_ != TYPE_OBJECT)
+        init_object();
+    for (auto& [key, value] : patch.members()) {
+        if (value.is_null()) {
+            std::map<std::string, JSON, std::less<>>& object = members();
+            auto it = object.find(key);
+            if (it != object.end())
+                object.erase(it);
+        } else {
+            (*this)[key].merge_patch(std::move(value));
+        }
+    }
+}
+
+JSON JSON::diff(const JSON& source, const JSON& target) {
+    JSON ops = array();
+    std::string path;
+    diff(ops.elements(), path, source, target);
+    return ops;
+}
+
+JSON::Table JSON::to_columns() const {
+    Table table;
+    if (type_ != TYPE_ARRAY)
+        return table;
+    each_element([&](const JSON& record) {
+        if (record.type_ == TYPE_OBJECT) {
+            for (const auto& [key, value] : record.members())
+                table.add(key, value);
+        }
+        table.end_row();
+    });
+    return table;
+}
+
+const JSON::Table::Column* JSON::Table::column(std::string_view key) const {
+    auto it = columns_.find(key);
+    return it != columns_.end() ? &it->second : nullptr;
+}
+
+bool JSON::Table::parse(const std::string& src, Status* status) {
+    *this = {};
+    const char* start = src.data();
+    const char* end = src.data() + src.size();
+    Status s1 = decode(start, end);
+#ifdef JSON_STRICT
+    if (s1 == SUCCESS) {
+        int ctx = 0;
+        Status s2 = scan(start, end, ctx, 0);
+        if (s2 != END)
+            s1 = TRAILING_CONTENT;
+    }
+#endif  // JSON_STRICT
+    if (status != nullptr)
+        *status = s1;
+    return s1 == SUCCESS;
+}
+
+JSON::Status JSON::Table::decode(const char*& start, const char* end) {
+    int ctx = 0;
+    Status status = scan(start, end, ctx, 0);
+    if (status != SUCCESS)
+        return status;
+    if (*start != '[')
+        return TYPE_MISMATCH;
+    ++start;
+    ctx = CTX_ARRAY;
+    JSON key, value;
+    for (;;) {
+        status = scan(start, end, ctx, 1);
+        if (status != SUCCESS)
+            return status;
+        if (*start == ']') {
+            ++start;
+            return SUCCESS;
+        }
+        if (*start == '{') {
+#ifdef JSON_STRICT
+            if (ctx & (CTX_KEY | CTX_COLON | CTX_COMMA))
+                return UNEXPECTED_OBJECT;
+#endif  // JSON_STRICT
+            ++start;
+            int members = CTX_OBJECT | CTX_KEY;
+            for (;;) {
+                status = key.decode(start, end, members, 2, nullptr);
+                if (status == END)
+                    break;
+                if (status != SUCCESS)
+                    return status;
+                if (key.type_ != TYPE_STRING)
+                    return INVALID_KEY_TYPE;
+                status = value.decode(start, end, CTX_COLON, 2, nullptr);
+                if (status != SUCCESS)
+                    return status;
+                add(key.as_string_, std::move(value));
+                members = CTX_OBJECT | CTX_KEY | CTX_COMMA;
+            }
+        } else {
+            status = value.decode(start, end, ctx, 1, &SKIP);
+            if (status != SUCCESS)
+                return status;
+        }
+        end_row();
+        ctx = CTX_ARRAY | CTX_COMMA;
+    }
+}
+
+void JSON::Table::add(std::string_view key, JSON value) {
+    auto it = columns_.find(key);
+    if (it == columns_.end())
+        it = columns_.emplace(key, Column{}).first;
+    Column& column = it->second;
+    if (column.nulls.size() > rows_)
+        return;  // duplicate key, the first value is kept like in objects
+    while (column.nulls.size() < rows_)
+        append(column, nullptr);
+    append(column, std::move(value));
+}
+
+void JSON::Table::end_row() {
+    ++rows_;
+    for (auto& [key, column] : columns_) {
+        if (column.nulls.size() < rows_)
+            append(column, nullptr);
+    }
+}
+
+void JSON::Table::append(Column& column, JSON value) {
+    bool null = value.type_ == TYPE_NULL;
+    if (!null && !column.mixed && value.type_ != column.type) {
+        if (column.type == TYPE_NULL) {  // the first value, earlier rows are null
+            column.type = value.type_;
+            std::size_t rows = column.nulls.size();
+            switch (column.type) {
+                case TYPE_BOOL: {
+                    column.bools.resize(rows);
+                } break;
+                case TYPE_INT64: {
+                    column.int64s.resize(rows);
+                } break;
+                case TYPE_DOUBLE: {
+                    column.doubles.resize(rows);
+                } break;
+                case TYPE_STRING: {
+                    column.strings.resize(rows);
+                } break;
+                default: {
+                    column.values.resize(rows);
+                } break;
+            }
+        } else if (column.type == TYPE_INT64 && value.type_ == TYPE_DOUBLE) {
+            column.type = TYPE_DOUBLE;
+            column.doubles.assign(column.int64s.begin(), column.int64s.end());
+            column.int64s = {};
+        } else if (column.type != TYPE_DOUBLE || value.type_ != TYPE_INT64) {
+            mix(column);
+        }
+    }
+
+    column.nulls.push_back(null);
+    if (column.mixed || column.type == TYPE_ARRAY || column.type == TYPE_OBJECT) {
+        column.values.push_back(std::move(value));
+        return;
+    }
+    switch (column.type) {
+        case TYPE_BOOL: {
+            column.bools.push_back(value.get_bool());
+        } break;
+        case TYPE_INT64: {
+            column.int64s.push_back(value.get_int64());
+        } break;
+        case TYPE_DOUBLE: {
+            column.doubles.push_back(value.get_double());
+        } break;
+        case TYPE_STRING: {
+            column.strings.push_back(null ? std::string{} : std::move(value.as_string_));
+        } break;
+        default:  // only nulls so far
+            break;
+    }
+}
+
+void JSON::Table::mix(Column& column) {  // moves the typed values to values
+    column.mixed = true;
+    if (column.type == TYPE_ARRAY || column.type == TYPE_OBJECT)
+        return;
+    std::vector<JSON> values(column.nulls.size());
+    for (std::size_t i = 0; i < values.size(); ++i) {
+        if (column.nulls[i])
+            continue;
+        switch (column.type) {
             case TYPE_BOOL: {
-                as_bool_ = other.as_bool_;
+                values[i] = static_cast<bool>(column.bools[i]);
             } break;
             case TYPE_INT64: {
-                as_int64_ = other.as_int64_;
+                values[i] = column.int64s[i];
             } break;
             case TYPE_DOUBLE: {
-                as_double_ = other.as_double_;
+                values[i] = column.doubles[i];
             } break;
             case TYPE_STRING: {
-                new (&as_string_) std::string{std::move(other.as_string_)};
-            } break;
-            case TYPE_ARRAY: {
-                new (&as_array_) std::vector{std::move(other.as_array_)};
-            } break;
-            case TYPE_OBJECT: {
-                new (&as_object_) std::map{std::move(other.as_object_)};
+                values[i] = std::move(column.strings[i]);
             } break;
             default:
-                assert(false);
+                break;
+        }
+    }
+    column.bools = {};
+    column.int64s = {};
+    column.doubles = {};
+    column.strings = {};
+    column.values = std::move(values);
+}
+
+bool JSON::Path::compile(std::string_view path, Status* status) {
+    steps_.clear();
+    const char* p = path.data();
+    const char* end = path.data() + path.size();
+    bool valid = p < end && *p++ == '$';
+    while (valid && p < end) {
+        Step step;
+        if (*p == '.') {
+            ++p;
+            step.recursive = p < end && *p == '.';
+            p += step.recursive;
+            if (step.recursive && p < end && *p == '[') {
+                valid = bracket(p, end, step);
+            } else if (p < end && *p == '*') {
+                ++p;
+                step.kind = Step::WILDCARD;
+            } else {
+                step.kind = Step::NAME;
+                valid = path_name(p, end, step.name);
+            }
+        } else if (*p == '[') {
+            valid = bracket(p, end, step);
+        } else {
+            valid = false;
+        }
+        steps_.push_back(std::move(step));
+    }
+
+    if (!valid)
+        steps_.clear();
+    if (status != nullptr)
+        *status = valid ? SUCCESS : INVALID_PATH;
+    return valid;
+}
+
+std::vector<const JSON*> JSON::Path::select(const JSON& json) const {
+    std::vector<const JSON*> results;
+    select(json, 0, results);
+    return results;
+}
+
+std::vector<std::string_view> JSON::Path::select_text(std::string_view src, Status* status) const {
+    std::vector<std::string_view> views;
+    const char* start = src.data();
+    const char* end = src.data() + src.size();
+    Status s1 = match(start, end, 0, 0, 0, views);
+#ifdef JSON_STRICT
+    if (s1 == SUCCESS) {
+        int ctx = 0;
+        Status s2 = scan(start, end, ctx, 0);
+        if (s2 != END)
+            s1 = TRAILING_CONTENT;
+    }
+#endif  // JSON_STRICT
+    if (s1 != SUCCESS)
+        views.clear();
+    if (status != nullptr)
+        *status = s1;
+    return views;
+}
+
+bool JSON::Path::bracket(const char*& p, const char* end, Step& step) {
+    ++p;  // [
+    path_space(p, end);
+    if (p == end)
+        return false;
+    if (*p == '*') {
+        ++p;
+        step.kind = Step::WILDCARD;
+    } else if (*p == '\'' || *p == '"') {
+        step.kind = Step::NAME;
+        if (!path_quoted(p, end, step.name))
+            return false;
+    } else if (*p == '?') {
+        ++p;
+        step.kind = Step::FILTER;
+        if (!filter(p, end, step))
+            return false;
+    } else {
+        std::int64_t bounds[3] = {0, INT64_MAX, 1};
+        bool index = path_number(p, end, bounds[0]);
+        int colons = 0;
+        for (; colons < 2 && p < end && *p == ':'; ++colons) {
+            ++p;
+            path_number(p, end, bounds[colons + 1]);
+        }
+        if (colons == 0 && !index)
+            return false;
+        step.kind = colons == 0 ? Step::INDEX : Step::SLICE;
+        step.start = bounds[0];
+        step.end = bounds[1];
+        step.step = bounds[2];
+        if (step.step <= 0)
+            return false;  // backward slices aren't supported
+    }
+    path_space(p, end);
+    return p < end && *p++ == ']';
+}
+
+bool JSON::Path::filter(const char*& p, const char* end, Step& step) {
+    path_space(p, end);
+    bool parens = p < end && *p == '(';
+    p += parens;
+    path_space(p, end);
+    if (p == end || *p++ != '@')
+        return false;
+    while (p < end && (*p == '.' || *p == '[')) {
+        std::string& key = step.keys.emplace_back();
+        if (*p++ == '.') {
+            if (!path_name(p, end, key))
+                return false;
+        } else {
+            path_space(p, end);
+            if (p == end || (*p != '\'' && *p != '"') || !path_quoted(p, end, key))
+                return false;
+            path_space(p, end);
+            if (p == end || *p++ != ']')
+                return false;
+        }
+    }
+
+    path_space(p, end);
+    static const struct {
+        const char* token;
+        Step::Op op;
+    } OPS[] = {
+        {"==", Step::EQ}, {"!=", Step::NE}, {"<=", Step::LE},
+        {">=", Step::GE}, {"<", Step::LT},  {">", Step::GT},
+    };
+    for (const auto& [token, op] : OPS) {
+        std::size_t length = std::strlen(token);
+        if (static_cast<std::size_t>(end - p) >= length && std::strncmp(p, token, length) == 0) {
+            p += length;
+            step.op = op;
+            break;
+        }
+    }
+
+    if (step.op != Step::EXISTS) {  // literal
+        path_space(p, end);
+        if (p < end && (*p == '\'' || *p == '"')) {
+            std::string string;
+            if (!path_quoted(p, end, string))
+                return false;
+            step.value = std::move(string);
+        } else {
+            const char* first = p;
+            while (p < end && (std::isalnum(static_cast<unsigned char>(*p)) || *p == '.' ||
+                               *p == '-' || *p == '+'))
+                ++p;
+            std::string_view token{first, static_cast<std::size_t>(p - first)};
+            std::int64_t int64 = 0;
+            double number = 0;
+            if (token == "true" || token == "false") {
+                step.value = token == "true";
+            } else if (token == "null") {
+                step.value = nullptr;
+            } else if (std::from_chars(first, p, int64).ptr == p && p > first) {
+                step.value = int64;
+            } else if (std::from_chars(first, p, number).ptr == p && p > first) {
+                step.value = number;
+            } else {
+                return false;
+            }
+        }
+    }
+
+    path_space(p, end);
+    return !parens || (p < end && *p++ == ')');
+}
+
+// whether the step selects the member or the element, filters are tested separately
+bool JSON::Path::selects(const Step& step,
+                         bool object,
+                         std::string_view key,
+                         std::size_t idx,
+                         std::size_t length) {
+    std::int64_t i = static_cast<std::int64_t>(idx);
+    std::int64_t n = static_cast<std::int64_t>(length);
+    switch (step.kind) {
+        case Step::NAME:
+            return object && key == step.name;
+        case Step::INDEX:
+            return !object && i == (step.start < 0 ? n + step.start : step.start);
+        case Step::SLICE: {
+            if (object)
+                return false;
+            std::int64_t lo = step.start < 0 ? n + step.start : step.start;
+            std::int64_t hi = step.end < 0 ? n + step.end : step.end;
+            lo = lo > 0 ? lo : 0;
+            return i >= lo && i < hi && (i - lo) % step.step == 0;
+        }
+        default:
+            return true;
+    }
+}
+
+bool JSON::Path::test(const Step& step, const JSON& value) {
+    const JSON* target = &value;
+    for (const std::string& key : step.keys) {
+        target = target->find(key);
+        if (target == nullptr)
+            return false;
+    }
+    if (step.op == Step::EXISTS)
+        return true;
+
+    const JSON& literal = step.value;
+    bool numbers = (target->is_int64() || target->is_double()) &&
+                   (literal.is_int64() || literal.is_double());
+    if (!numbers && target->type_ != literal.type_)
+        return step.op == Step::NE;
+    if (step.op == Step::EQ)
+        return *target == literal;
+    if (step.op == Step::NE)
+        return *target != literal;
+    if (!numbers && !target->is_string())
+        return false;  // booleans, nulls and containers are only compared for equality
+    std::partial_ordering cmp = *target <=> literal;
+    switch (step.op) {
+        case Step::LT:
+            return cmp < 0;
+        case Step::LE:
+            return cmp <= 0;
+        case Step::GT:
+            return cmp > 0;
+        default:
+            return cmp >= 0;
+    }
+}
+
+void JSON::Path::select(const JSON& json,
+                        std::size_t step,
+                        std::vector<const JSON*>& results) const {
+    if (step == steps_.size()) {
+        results.push_back(&json);
+        return;
+    }
+
+    const Step& s = steps_[step];
+    auto child = [&](const JSON& value, bool selected) {
+        if (selected && (s.kind != Step::FILTER || test(s, value)))
+            select(value, step + 1, results);
+        if (s.recursive)
+            select(value, step, results);
+    };
+    if (json.type_ == TYPE_OBJECT) {
+        for (const auto& [key, value] : json.members())
+            child(value, selects(s, true, key, 0, 0));
+    } else if (json.type_ == TYPE_ARRAY) {
+        const std::vector<JSON>& array = json.elements();
+        for (std::size_t i = 0; i < array.size(); ++i)
+            child(array[i], selects(s, false, {}, i, array.size()));
+    }
+}
+
+JSON::Status JSON::Path::match(const char*& start,
+                               const char* end,
+                               int ctx,
+                               std::size_t depth,
+                               std::size_t step,
+                               std::vector<std::string_view>& views) const {
+    if (depth > JSON_MAX_DEPTH)
+        return DEPTH_EXCEEDED;
+
+    Status status = scan(start, end, ctx, depth);
+    if (status != SUCCESS)
+        return status;
+    const char* first = start;
+    if (step == steps_.size() || (*start != '{' && *start != '[')) {
+        JSON skipped;
+        status = skipped.decode(start, end, ctx, depth, &SKIP);
+        if (status == SUCCESS && step == steps_.size())
+            views.emplace_back(first, start - first);
+        return status;
+    }
+
+    const Step& s = steps_[step];
+    bool object = *start == '{';
+#ifdef JSON_STRICT
+    if (ctx & (CTX_KEY | CTX_COLON | CTX_COMMA))
+        return object ? UNEXPECTED_OBJECT : UNEXPECTED_ARRAY;
+#endif  // JSON_STRICT
+    std::size_t length = 0;
+    bool relative = s.start < 0 || (s.kind == Step::SLICE && s.end < 0);
+    if (!object && relative && (s.kind == Step::INDEX || s.kind == Step::SLICE)) {
+        JSON skipped;  // counted first, indices are relative to the end
+        const char* c = start + 1;
+        for (int inner = CTX_ARRAY;; inner = CTX_ARRAY | CTX_COMMA, ++length) {
+            status = skipped.decode(c, end, inner, depth + 1, &SKIP);
+            if (status == END)
+                break;
+            if (status != SUCCESS)
+                return status;
+        }
+    }
+
+    ++start;
+    int inner = object ? CTX_OBJECT | CTX_KEY : CTX_ARRAY;
+    JSON key, value;
+    for (std::size_t idx = 0;; ++idx) {
+        if (object) {
+            status = key.decode(start, end, inner, depth + 1, nullptr);
+            if (status == END)
+                return SUCCESS;
+            if (status != SUCCESS)
+                return status;
+            if (key.type_ != TYPE_STRING)
+                return INVALID_KEY_TYPE;
+            inner = CTX_COLON;
         }
+        status = scan(start, end, inner, depth + 1);
+        if (status != SUCCESS)
+            return status;
+        if (!object && (*start == ']' || *start == '}')) {
+            status = value.decode(start, end, inner, depth + 1, &SKIP);
+            return status == END ? SUCCESS : status;
+        }
+
+        // the value is walked again for every way it's matched, then skipped
+        const char* next = nullptr;
+        bool selected = selects(s, object, object ? key.as_string_ : "", idx, length);
+        if (selected && s.kind == Step::FILTER) {
+            const char* c = start;
+            status = value.decode(c, end, inner, depth + 1, nullptr);
+            if (status != SUCCESS)
+                return status;
+            selected = test(s, value);
+            next = c;
+        }
+        if (selected) {
+            const char* c = start;
+            status = match(c, end, inner, depth + 1, step + 1, views);
+            if (status != SUCCESS)
+                return status;
+            next = c;
+        }
+        if (s.recursive) {
+            const char* c = start;
+            status = match(c, end, inner, depth + 1, step, views);
+            if (status != SUCCESS)
+                return status;
+            next = c;
+        }
+        if (next != nullptr) {
+            start = next;
+        } else {
+            status = value.decode(start, end, inner, depth + 1, &SKIP);
+            if (status != SUCCESS)
+                return status;
+        }
+        inner = object ? CTX_OBJECT | CTX_KEY | CTX_COMMA : CTX_ARRAY | CTX_COMMA;
     }
+}
+
+JSON::Documents JSON::parse_many(std::string_view src, unsigned threads) {
+    return Documents{src, threads};
+}
+
+JSON::Documents::Documents(std::string_view src, unsigned threads)
+    : src_(src), threaded_(threads > 1) {
+    if (!threaded_)
+        return;
+
+    // the boundaries are found by skipping the documents, then every thread decodes a share
+    std::vector<std::size_t> ends;
+    while (next(batch_.emplace_back(), &SKIP, nullptr))
+        ends.push_back(offset_);
+    batch_.pop_back();
+
+    if (batch_.empty())
+        return;
+    auto decode = [this, &ends](std::size_t first, std::size_t last) {
+        Scratch scratch;
+        for (std::size_t i = first; i < last; ++i) {
+            Document& document = batch_[i];
+            if (document.status != SUCCESS)
+                continue;
+            const char* start = src_.data() + document.offset;
+            Decoder decoder;
+            decoder.scratch = &scratch;
+            document.status = document.json.decode(start, src_.data() + ends[i], 0, 0, nullptr,
+                                                   nullptr, &decoder);
+            scratch.elements.clear();
+        }
+    };
+
+    // no more threads than cores or documents, the calling thread decodes the first share
+    unsigned cores = std::thread::hardware_concurrency();
+    std::size_t count = std::min<std::size_t>({threads, cores != 0 ? cores : threads,
+                                               batch_.size()});
+    std::size_t share = (batch_.size() + count - 1) / count;
+    std::vector<std::thread> workers;
+    for (std::size_t first = share; first < batch_.size(); first += share)
+        workers.emplace_back(decode, first, std::min(first + share, batch_.size()));
+    decode(0, share);
+    for (std::thread& worker : workers)
+        worker.join();
+}
 
+JSON::Documents::iterator JSON::Documents::begin() {
+    iterator it;
+    if (current_ != nullptr || next())
+        it.documents_ = this;
+    return it;
+}
+
+JSON::Documents::iterator& JSON::Documents::iterator::operator++() {
+    if (!documents_->next())
+        documents_ = nullptr;
     return *this;
 }
 
-JSON::Type JSON::type() const {
-    return type_;
+bool JSON::Documents::next() {
+    if (threaded_) {
+        current_ = idx_ < batch_.size() ? &batch_[idx_++] : nullptr;
+        return current_ != nullptr;
+    }
+    current_ = next(document_, nullptr, &scratch_) ? &document_ : nullptr;
+    return current_ != nullptr;
 }
 
-bool JSON::is_null() const {
-    return type_ == TYPE_NULL;
+bool JSON::Documents::next(Document& document, const JSON* projection, Scratch* scratch) {
+    const char* start = src_.data() + offset_;
+    const char* end = src_.data() + src_.size();
+    int ctx = 0;
+    Status status = scan(start, end, ctx, 0);
+#ifndef JSON_STRICT
+    while (status == SUCCESS && (*start == ']' || *start == '}')) {  // stray closing brackets
+        ++start;
+        status = scan(start, end, ctx, 0);
+    }
+#endif  // JSON_STRICT
+    if (status == END)
+        return false;
+
+    Decoder decoder;
+    decoder.scratch = scratch;
+    document.offset = start - src_.data();
+    status = document.json.decode(start, end, 0, 0, projection, nullptr, &decoder);
+    if (scratch != nullptr)
+        scratch->elements.clear();
+    document.status = status;
+    if (status != SUCCESS) {
+        const char* line = static_cast<const char*>(std::memchr(start, '\n', end - start));
+        start = line != nullptr ? line + 1 : end;
+    }
+    offset_ = start - src_.data();
+    return true;
 }
 
-bool JSON::is_bool() const {
-    return type_ == TYPE_BOOL;
+JSON::Elements JSON::parse_stream(std::function<std::size_t(char*, std::size_t)> read,
+                                  std::size_t chunk) {
+    return Elements{std::move(read), chunk};
+}
+
+JSON::Elements::Elements(Read read, std::size_t chunk)
+    : read_(std::move(read)), chunk_(chunk > 0 ? chunk : 1) {}
+
+JSON::Elements::iterator JSON::Elements::begin() {
+    if (!begun_) {
+        begun_ = true;
+        more_ = next();
+    }
+    iterator it;
+    if (more_)
+        it.elements_ = this;
+    return it;
+}
+
+JSON::Elements::iterator& JSON::Elements::iterator::operator++() {
+    elements_->more_ = elements_->next();
+    if (!elements_->more_)
+        elements_ = nullptr;
+    return *this;
+}
+
+bool JSON::Elements::next() {
+    current_ = nullptr;  // the previous element is freed before the next one is read
+    while (status_ == SUCCESS) {
+        const char* data = buffer_.data();
+        const char* start = data + pos_;
+        const char* end = data + buffer_.size();
+        int ctx = ctx_;
+        Status status = scan(start, end, ctx, opened_ && !closed_ ? 1 : 0);
+        if (status != SUCCESS && start + 1 >= end && fill())
+            continue;  // the text ran out, or was cut after the / of a comment
+
+        if (closed_) {
+#ifdef JSON_STRICT
+            status_ = status == END ? SUCCESS : status == SUCCESS ? TRAILING_CONTENT : status;
+#endif  // JSON_STRICT
+            return false;
+        }
+        if (status != SUCCESS) {
+            if (status == END && opened_)
+                closed_ = true;  // unclosed arrays end with the text when not strict
+            else
+                status_ = status;
+            return false;
+        }
+
+        if (!opened_) {
+            if (*start != '[') {
+                status_ = TYPE_MISMATCH;
+                return false;
+            }
+            opened_ = true;
+            ctx_ = CTX_ARRAY;
+            pos_ = start + 1 - data;
+            continue;
+        }
+
+        if (*start == ']' || *start == '}') {
+            JSON closing;
+            status = closing.decode(start, end, ctx, 1, &SKIP);
+            if (status != END) {
+                status_ = status;
+                return false;
+            }
+            closed_ = true;
+            pos_ = start - data;
+            continue;
+        }
+
+        std::size_t last = extent(start - data);
+        if (last == std::string::npos) {
+            if (fill())
+                continue;
+            last = buffer_.size();  // the decoder reports what's missing
+        }
+        Decoder decoder;
+        decoder.scratch = &scratch_;  // the previous element's storage is reused
+        status = current_.decode(start, data + last, ctx, 1, nullptr, nullptr, &decoder);
+        scratch_.elements.clear();
+        if (status != SUCCESS) {
+            status_ = status;
+            return false;
+        }
+        ctx_ = CTX_ARRAY | CTX_COMMA;
+        pos_ = start - data;
+        return true;
+    }
+    return false;
+}
+
+// reads the next chunk after dropping the text already read, false at the end of the stream
+bool JSON::Elements::fill() {
+    if (eof_)
+        return false;
+    buffer_.erase(0, pos_);
+    if (scan_first_ != std::string::npos) {
+        scan_first_ -= pos_;
+        scan_next_ -= pos_;
+    }
+    pos_ = 0;
+    std::size_t size = buffer_.size();
+    buffer_.resize(size + chunk_);
+    std::size_t read = read_(buffer_.data() + size, chunk_);
+    buffer_.resize(size + read);
+    eof_ = read == 0;
+    return !eof_;
+}
+
+// end of the element starting at first, or npos if it isn't buffered whole yet, then the
+// next call for the same element resumes where this one stopped
+std::size_t JSON::Elements::extent(std::size_t first) {
+    if (first != scan_first_) {
+        scan_first_ = first;
+        scan_next_ = first;
+        scan_depth_ = 0;
+        scan_string_ = false;
+        scan_comment_ = false;
+    }
+
+    std::size_t& depth = scan_depth_;
+    bool& string = scan_string_;
+    bool& comment = scan_comment_;
+    std::size_t i = scan_next_;
+    for (; i < buffer_.size(); ++i) {
+        char c = buffer_[i];
+        std::size_t last = std::string::npos;
+        if (comment) {
+            comment = c != '\n';
+        } else if (string) {
+            if (c == '\\') {
+                ++i;  // past the end of the buffer if the escaped character isn't read yet
+            } else if (c == '"') {
+                string = false;
+                if (depth == 0)
+                    last = i + 1;
+            }
+        } else if (c == '"') {
+            string = true;
+        } else if (c == '[' || c == '{') {
+            ++depth;
+        } else if (c == ']' || c == '}') {
+            if (depth == 0)
+                last = i;  // a number or literal ended by the end of the array
+            else if (--depth == 0)
+                last = i + 1;
+        } else if (c == '/' && depth > 0) {  // comment, brackets in it don't count
+            comment = true;
+        } else if (depth == 0 && (c == ',' || c == '/' || c == ' ' || c == '\n' || c == '\r' ||
+                                  c == '\t')) {
+            last = i;  // end of a number or literal
+        }
+        if (last != std::string::npos) {
+            scan_first_ = std::string::npos;
+            return last;
+        }
+    }
+    scan_next_ = i;
+    return std::string::npos;
+}
+
+std::shared_ptr<const JSON> JSON::freeze() const& {
+    return JSON{*this}.freeze();
+}
+
+std::shared_ptr<const JSON> JSON::freeze() && {
+    std::shared_ptr<const JSON> json = std::make_shared<const JSON>(std::move(*this));
+    // fill the lazy caches now, so that readers never write to the document
+    json->warm();
+#ifdef JSON_HASH_CACHE
+    json->hash(true);
+#endif  // JSON_HASH_CACHE
+    return json;
+}
+
+JSON::Atomic::Atomic() : json_{JSON{}.freeze()} {}
+
+JSON::Atomic::Atomic(std::shared_ptr<const JSON> json) : json_{std::move(json)} {}
+
+#ifdef __cpp_lib_atomic_shared_ptr
+std::shared_ptr<const JSON> JSON::Atomic::load() const {
+    return json_.load(std::memory_order_acquire);
+}
+
+void JSON::Atomic::store(std::shared_ptr<const JSON> json) {
+    json_.store(std::move(json), std::memory_order_release);
+}
+
+std::shared_ptr<const JSON> JSON::Atomic::exchange(std::shared_ptr<const JSON> json) {
+    return json_.exchange(std::move(json), std::memory_order_acq_rel);
+}
+#else   // __cpp_lib_atomic_shared_ptr
+std::shared_ptr<const JSON> JSON::Atomic::load() const {
+    std::lock_guard<std::mutex> lock{mutex_};
+    return json_;
+}
+
+void JSON::Atomic::store(std::shared_ptr<const JSON> json) {
+    exchange(std::move(json));  // the old document is released outside of the lock
+}
+
+std::shared_ptr<const JSON> JSON::Atomic::exchange(std::shared_ptr<const JSON> json) {
+    std::lock_guard<std::mutex> lock{mutex_};
+    json_.swap(json);
+    return json;
+}
+#endif  // __cpp_lib_atomic_shared_ptr
+
+#ifdef JSON_RAW_NUMBERS
+std::uint64_t JSON::convert() const {
+    // racing readers convert the same text, so whichever store wins is fine
+    if (as_raw_.converted.load(std::memory_order_acquire))
+        return as_raw_.bits.load(std::memory_order_relaxed);
+    std::uint64_t bits;
+    if (type_ == TYPE_INT64) {
+        const std::string& text = as_raw_.text;
+        std::int64_t value;
+        if (std::from_chars(text.data(), text.data() + text.size(), value).ec != std::errc{}) {
+            value = text[0] == '-' ? INT64_MIN : INT64_MAX;  // saturated, like strtoll()
+            as_raw_.overflow.store(true, std::memory_order_relaxed);
+        }
+        bits = static_cast<std::uint64_t>(value);
+    } else {
+        bits = std::bit_cast<std::uint64_t>(std::strtod(as_raw_.text.c_str(), nullptr));
+    }
+    as_raw_.bits.store(bits, std::memory_order_relaxed);
+    as_raw_.converted.store(true, std::memory_order_release);
+    return bits;
 }
+#endif  // JSON_RAW_NUMBERS
 
-bool JSON::is_int64() const {
-    return type_ == TYPE_INT64;
+std::int64_t JSON::int64_value() const {
+#ifdef JSON_RAW_NUMBERS
+    if (raw_)
+        return static_cast<std::int64_t>(convert());
+#endif  // JSON_RAW_NUMBERS
+    return as_int64_;
 }
 
-bool JSON::is_double() const {
-    return type_ == TYPE_DOUBLE;
+double JSON::double_value() const {
+#ifdef JSON_RAW_NUMBERS
+    if (raw_)
+        return std::bit_cast<double>(convert());
+#endif  // JSON_RAW_NUMBERS
+    return as_double_;
 }
 
-bool JSON::is_string() const {
-    return type_ == TYPE_STRING;
+bool JSON::overflows() const {
+#ifdef JSON_RAW_NUMBERS
+    if (raw_ && type_ == TYPE_INT64) {
+        convert();
+        return as_raw_.overflow.load(std::memory_order_relaxed);
+    }
+#endif  // JSON_RAW_NUMBERS
+    return false;
 }
 
-bool JSON::is_array() const {
-    return type_ == TYPE_ARRAY;
+std::partial_ordering JSON::compare_integer(const JSON& other) const {
+#ifdef JSON_RAW_NUMBERS
+    // raw integers that don't fit into int64 are compared by their text
+    if (overflows() || other.overflows()) {
+        char buf1[24];
+        char buf2[24];
+        std::string_view text1 = as_raw_.text;
+        std::string_view text2 = other.as_raw_.text;
+        if (!overflows())
+            text1 = {buf1, std::to_chars(buf1, buf1 + sizeof(buf1), int64_value()).ptr};
+        if (!other.overflows())
+            text2 = {buf2, std::to_chars(buf2, buf2 + sizeof(buf2), other.int64_value()).ptr};
+        return integer_compare(text1, text2);
+    }
+#endif  // JSON_RAW_NUMBERS
+    return int64_value() <=> other.int64_value();
 }
 
-bool JSON::is_object() const {
-    return type_ == TYPE_OBJECT;
+// exact, converting the int64 to double would round values above 2^53
+std::partial_ordering JSON::compare_double(double value) const {
+    if (std::isnan(value))
+        return std::partial_ordering::unordered;
+#ifdef JSON_RAW_NUMBERS
+    if (overflows()) {
+        bool negative = as_raw_.text[0] == '-';
+        if (std::isinf(value))
+            return value > 0 ? std::partial_ordering::less : std::partial_ordering::greater;
+        if (value >= -0x1p63 && value < 0x1p63)
+            return negative ? std::partial_ordering::less : std::partial_ordering::greater;
+        char buf[320];  // doubles this large are integers, printed with all of their digits
+        std::to_chars_result result =
+            std::to_chars(buf, buf + sizeof(buf), value, std::chars_format::fixed, 0);
+        return integer_compare(as_raw_.text, {buf, result.ptr});
+    }
+#endif  // JSON_RAW_NUMBERS
+    std::int64_t int64 = int64_value();
+    if (value >= 0x1p63)
+        return std::partial_ordering::less;
+    if (value < -0x1p63)
+        return std::partial_ordering::greater;
+    std::int64_t integral = static_cast<std::int64_t>(value);  // truncated, so exact as double
+    if (int64 != integral)
+        return int64 <=> integral;
+    return static_cast<double>(integral) <=> value;
 }
 
-bool JSON::get_bool(bool fallback) const {
-    switch (type_) {
-        case TYPE_BOOL:
-            return as_bool_;
-        default:
-            return fallback;
+void JSON::warm() const {
+#ifdef JSON_RAW_NUMBERS
+    if (raw_)
+        convert();
+#endif  // JSON_RAW_NUMBERS
+    if (type_ == TYPE_ARRAY) {
+        each_element([](const JSON& value) { value.warm(); });
+    } else if (type_ == TYPE_OBJECT) {
+        for (const auto& [key, value] : members())
+            value.warm();
     }
 }
 
-std::int64_t JSON::get_int64(std::int64_t fallback) const {
-    switch (type_) {
-        case TYPE_INT64:
-            return as_int64_;
-        case TYPE_DOUBLE:
-            return as_double_;
-        default:
-            return fallback;
+// calls f with every element of the array, packed elements are passed as temporary values
+template <class F>
+void JSON::each_element(F&& f) const {
+#ifdef JSON_PACKED_ARRAYS
+    if (packed_) {
+        for (std::int64_t value : as_packed_->int64s)
+            f(JSON{value});
+        for (double value : as_packed_->doubles)
+            f(JSON{value});
+        return;
     }
+#endif  // JSON_PACKED_ARRAYS
+    for (const JSON& value : elements())
+        f(value);
 }
 
-double JSON::get_double(double fallback) const {
-    switch (type_) {
-        case TYPE_INT64:
-            return as_int64_;
-        case TYPE_DOUBLE:
-            return as_double_;
-        default:
-            return fallback;
+#ifdef JSON_PACKED_ARRAYS
+// packs the values if there are enough of them and they're all int64 or all double, raw numbers
+// only if they're written the way encode() would write them, so that dump() doesn't change
+JSON::Packed* JSON::pack(std::span<const JSON> values) {
+    if (values.size() < PACKED_MIN)
+        return nullptr;
+    Type type = values.front().type_;
+    if (type != TYPE_INT64 && type != TYPE_DOUBLE)
+        return nullptr;
+    for (const JSON& value : values) {
+        if (value.type_ != type)
+            return nullptr;
+#ifdef JSON_RAW_NUMBERS
+        if (value.raw_) {
+            char buf[128];
+            std::to_chars_result result =
+                type == TYPE_INT64 ? std::to_chars(buf, buf + sizeof(buf), value.int64_value())
+                                   : std::to_chars(buf, buf + sizeof(buf), value.double_value());
+            if (std::string_view{buf, result.ptr} != value.as_raw_.text)
+                return nullptr;
+        }
+#endif  // JSON_RAW_NUMBERS
     }
-}
 
-std::string& JSON::get_string(const std::string& fallback) {
-    if (type_ != TYPE_STRING) {
-        init_string();
-        as_string_ = std::move(fallback);
+    Packed* packed = new Packed{type, {}, {}};
+    if (type == TYPE_INT64) {
+        packed->int64s.reserve(values.size());
+        for (const JSON& value : values)
+            packed->int64s.push_back(value.int64_value());
+    } else {
+        packed->doubles.reserve(values.size());
+        for (const JSON& value : values)
+            packed->doubles.push_back(value.double_value());
     }
+    return packed;
+}
 
-    return as_string_;
+std::vector<JSON> JSON::expand(const Packed& packed) {
+    std::vector<JSON> array;
+    array.reserve(packed.int64s.size() + packed.doubles.size());
+    for (std::int64_t value : packed.int64s)
+        array.emplace_back(value);
+    for (double value : packed.doubles)
+        array.emplace_back(value);
+    return array;
 }
 
-std::vector<JSON>& JSON::get_array(const std::vector<JSON>& fallback) {
-    if (type_ != TYPE_ARRAY) {
-        init_array();
-        as_array_ = std::move(fallback);
-    }
+void JSON::release(Packed* packed) {
+#ifdef JSON_COW
+    if (packed->refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+#endif  // JSON_COW
+    delete packed->nodes.load(std::memory_order_acquire);
+    delete packed;
+}
+
+void JSON::unpack() {  // before the array is modified, elements can change their type
+    std::vector<JSON>* nodes = nullptr;
+#ifdef JSON_COW
+    if (as_packed_->refs.load(std::memory_order_acquire) == 1)  // copies keep their nodes
+#endif  // JSON_COW
+        nodes = as_packed_->nodes.exchange(nullptr, std::memory_order_acquire);
+    std::vector<JSON> array = nodes != nullptr ? std::move(*nodes) : expand(*as_packed_);
+    delete nodes;
+    init_array();
+    elements() = std::move(array);
+}
+#endif  // JSON_PACKED_ARRAYS
 
+std::vector<JSON>& JSON::elements() {
+#ifdef JSON_HASH_CACHE
+    hash_.store(0, std::memory_order_relaxed);
+#endif  // JSON_HASH_CACHE
+#ifdef JSON_PACKED_ARRAYS
+    if (packed_)
+        unpack();
+#endif  // JSON_PACKED_ARRAYS
+#ifdef JSON_COW
+    return detach(as_array_);
+#else   // JSON_COW
     return as_array_;
+#endif  // JSON_COW
 }
 
-std::map<std::string, JSON>& JSON::get_object(const std::map<std::string, JSON>& fallback) {
-    if (type_ != TYPE_OBJECT) {
-        init_object();
-        as_object_ = std::move(fallback);
+const std::vector<JSON>& JSON::elements() const {
+#ifdef JSON_PACKED_ARRAYS
+    if (packed_) {
+        // expanded once, racing readers keep whichever nodes were published first
+        std::vector<JSON>* nodes = as_packed_->nodes.load(std::memory_order_acquire);
+        if (nodes == nullptr) {
+            std::vector<JSON>* expanded = new std::vector<JSON>{expand(*as_packed_)};
+            if (as_packed_->nodes.compare_exchange_strong(nodes, expanded,
+                                                          std::memory_order_acq_rel))
+                nodes = expanded;
+            else
+                delete expanded;
+        }
+        return *nodes;
     }
+#endif  // JSON_PACKED_ARRAYS
+#ifdef JSON_COW
+    return as_array_->value;
+#else   // JSON_COW
+    return as_array_;
+#endif  // JSON_COW
+}
 
+std::map<std::string, JSON, std::less<>>& JSON::members() {
+#ifdef JSON_HASH_CACHE
+    hash_.store(0, std::memory_order_relaxed);
+#endif  // JSON_HASH_CACHE
+#ifdef JSON_COW
+    return detach(as_object_);
+#else   // JSON_COW
     return as_object_;
+#endif  // JSON_COW
 }
 
-JSON& JSON::operator[](std::size_t idx) {
-    if (type_ != TYPE_ARRAY)
-        init_array();
-    if (idx >= as_array_.size())
-        as_array_.resize(idx + 1);
-    return as_array_[idx];
+const std::map<std::string, JSON, std::less<>>& JSON::members() const {
+#ifdef JSON_COW
+    return as_object_->value;
+#else   // JSON_COW
+    return as_object_;
+#endif  // JSON_COW
 }
 
-JSON& JSON::operator[](const std::string& key) {
-    if (type_ != TYPE_OBJECT)
-        init_object();
-    return as_object_[key];
+bool JSON::shares(const JSON& other) const {
+#ifdef JSON_PACKED_ARRAYS
+    if (packed_ || other.packed_)
+        return this == &other || (packed_ && other.packed_ && as_packed_ == other.as_packed_);
+#endif  // JSON_PACKED_ARRAYS
+#ifdef JSON_COW
+    if (type_ == TYPE_ARRAY && other.type_ == TYPE_ARRAY)
+        return as_array_ == other.as_array_;
+    if (type_ == TYPE_OBJECT && other.type_ == TYPE_OBJECT)
+        return as_object_ == other.as_object_;
+#endif  // JSON_COW
+    return this == &other;
 }
 
-std::size_t JSON::size() const {
-    switch (type_) {
-        case TYPE_STRING:
-            return as_string_.size();
-        case TYPE_ARRAY:
-            return as_array_.size();
-        case TYPE_OBJECT:
-            return as_object_.size();
-        default:
-            return 0;
-    }
+#ifdef JSON_COW
+void JSON::dedupe() {
+    std::unordered_map<std::size_t, std::vector<const JSON*>> seen;
+    dedupe(seen);
 }
 
-bool JSON::empty() const {
-    return size() == 0;
+// children first, so a duplicate's subtree only holds duplicates and nothing seen is freed,
+// returns the hash, combined from those of the children like hash() does, so that every subtree
+// is hashed once instead of again at every level above it
+std::size_t JSON::dedupe(std::unordered_map<std::size_t, std::vector<const JSON*>>& seen) {
+    if (type_ != TYPE_ARRAY && type_ != TYPE_OBJECT)
+        return hash();
+    bool children = true;
+#ifdef JSON_PACKED_ARRAYS
+    children = !packed_;  // the numbers are stored in place, but the array can be shared
+#endif  // JSON_PACKED_ARRAYS
+
+    // storage that's already shared is only read, writing to it would copy it
+    std::size_t seed = size();
+    if (children && type_ == TYPE_ARRAY &&
+        as_array_->refs.load(std::memory_order_acquire) == 1) {
+        for (JSON& value : as_array_->value)
+            hash_combine(seed, value.dedupe(seen));
+    } else if (type_ == TYPE_OBJECT && as_object_->refs.load(std::memory_order_acquire) == 1) {
+        for (auto& [key, value] : as_object_->value) {
+            hash_combine(seed, std::hash<std::string>{}(key));
+            hash_combine(seed, value.dedupe(seen));
+        }
+    } else {
+        seed = hash();
+    }
+#ifdef JSON_HASH_CACHE
+    seed = seed != 0 ? seed : 1;
+#endif  // JSON_HASH_CACHE
+
+    std::vector<const JSON*>& candidates = seen[seed];
+    for (const JSON* candidate : candidates) {
+        if (identical(*candidate)) {
+            *this = *candidate;
+            return seed;
+        }
+    }
+    candidates.push_back(this);
+    return seed;
 }
 
-bool JSON::has(const std::string& key) const {
-    if (type_ != TYPE_OBJECT)
+// stricter than ==, numbers of different types or spellings would be written differently
+bool JSON::identical(const JSON& other) const {
+    if (shares(other))
+        return true;
+    if (type_ != other.type_)
         return false;
-    return as_object_.find(key) != as_object_.end();
-}
+#ifdef JSON_RAW_NUMBERS
+    if (raw_ || other.raw_)
+        return raw_ && other.raw_ && as_raw_.text == other.as_raw_.text;
+#endif  // JSON_RAW_NUMBERS
+#ifdef JSON_PACKED_ARRAYS
+    if (packed_ || other.packed_)
+        return packed_ && other.packed_ && as_packed_->type == other.as_packed_->type &&
+               as_packed_->int64s == other.as_packed_->int64s &&
+               std::equal(as_packed_->doubles.begin(), as_packed_->doubles.end(),
+                          other.as_packed_->doubles.begin(), other.as_packed_->doubles.end(),
+                          [](double a, double b) {
+                              return std::bit_cast<std::uint64_t>(a) ==
+                                     std::bit_cast<std::uint64_t>(b);
+                          });
+#endif  // JSON_PACKED_ARRAYS
 
-void JSON::clear() {
     switch (type_) {
-        case TYPE_STRING: {
-            as_string_.~basic_string();
-        } break;
+        case TYPE_DOUBLE:
+            return std::bit_cast<std::uint64_t>(as_double_) ==
+                   std::bit_cast<std::uint64_t>(other.as_double_);
         case TYPE_ARRAY: {
-            as_array_.~vector();
-        } break;
+            const std::vector<JSON>& a = as_array_->value;
+            const std::vector<JSON>& b = other.as_array_->value;
+            return std::equal(a.begin(), a.end(), b.begin(), b.end(),
+                              [](const JSON& x, const JSON& y) { return x.identical(y); });
+        }
         case TYPE_OBJECT: {
-            as_object_.~map();
-        } break;
+            const auto& a = as_object_->value;
+            const auto& b = other.as_object_->value;
+            return std::equal(a.begin(), a.end(), b.begin(), b.end(),
+                              [](const auto& x, const auto& y) {
+                                  return x.first == y.first && x.second.identical(y.second);
+                              });
+        }
         default:
-            break;
+            return *this == other;
     }
 }
 
-bool JSON::parse(const std::string& src, Status* status) {
-    const char* start = src.data();
-    const char* end = src.data() + src.size();
-    Status s1 = decode(start, end, 0, 0);
-#ifdef JSON_STRICT
-    if (s1 == SUCCESS) {
-        JSON j2;
-        Status s2 = j2.decode(start, end, 0, 0);
-        if (s2 != END)
-            s1 = TRAILING_CONTENT;
+template <class T>
+T& JSON::detach(Shared<T>*& shared) {
+    if (shared->refs.load(std::memory_order_acquire) != 1) {
+        Shared<T>* copy = new Shared<T>{{1}, shared->value};
+        release(shared);
+        shared = copy;
     }
-#endif  // JSON_STRICT
-    if (status != nullptr)
-        *status = s1;
-    return s1 == SUCCESS;
+    return shared->value;
 }
 
-std::string JSON::dump(bool pretty) const {
-    std::string string;
-    encode(string, pretty, 1);
-    return string;
+template <class T>
+void JSON::release(Shared<T>* shared) {
+    if (shared->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        delete shared;
 }
+#endif  // JSON_COW
 
-void JSON::init_string() {
+void JSON::init_string(Scratch* scratch) {
     clear();
     type_ = TYPE_STRING;
-    new (&as_string_) std::string{};
+    if (scratch != nullptr && !scratch->strings.empty())
+        new (&as_string_) std::string{take(scratch->strings)};
+    else
+        new (&as_string_) std::string{};
 }
 
-void JSON::init_array() {
+void JSON::init_array(Scratch* scratch) {
     clear();
     type_ = TYPE_ARRAY;
-    new (&as_array_) std::vector<JSON>{};
+    std::vector<JSON> array;
+    if (scratch != nullptr && !scratch->arrays.empty())
+        array = take(scratch->arrays);
+#ifdef JSON_COW
+    as_array_ = new Shared<std::vector<JSON>>{{1}, std::move(array)};
+#else   // JSON_COW
+    new (&as_array_) std::vector<JSON>{std::move(array)};
+#endif  // JSON_COW
 }
 
 void JSON::init_object() {
     clear();
     type_ = TYPE_OBJECT;
-    new (&as_object_) std::map<std::string, JSON>{};
+#ifdef JSON_COW
+    as_object_ = new Shared<std::map<std::string, JSON, std::less<>>>{{1}, {}};
+#else   // JSON_COW
+    new (&as_object_) std::map<std::string, JSON, std::less<>>{};
+#endif  // JSON_COW
+}
+
+// values are recycled last to first, so that the next parse takes the storage of the value
+// at the same position from the top of the scratch, empty and inline storage included
+void JSON::recycle(Scratch& scratch) {
+    switch (type_) {
+        case TYPE_STRING: {
+            as_string_.clear();
+            scratch.strings.push_back(std::move(as_string_));
+        } break;
+        case TYPE_ARRAY: {
+#ifdef JSON_PACKED_ARRAYS
+            if (packed_)
+                break;
+#endif  // JSON_PACKED_ARRAYS
+#ifdef JSON_COW
+            if (as_array_->refs.load(std::memory_order_acquire) != 1)
+                break;  // still used by a copy
+            std::vector<JSON>& array = as_array_->value;
+#else   // JSON_COW
+            std::vector<JSON>& array = as_array_;
+#endif  // JSON_COW
+            for (auto it = array.rbegin(); it != array.rend(); ++it)
+                it->recycle(scratch);
+            array.clear();
+            scratch.arrays.push_back(std::move(array));
+        } break;
+        case TYPE_OBJECT: {
+#ifdef JSON_COW
+            if (as_object_->refs.load(std::memory_order_acquire) != 1)
+                break;
+            std::map<std::string, JSON, std::less<>>& object = as_object_->value;
+#else   // JSON_COW
+            std::map<std::string, JSON, std::less<>>& object = as_object_;
+#endif  // JSON_COW
+            while (!object.empty()) {
+                auto node = object.extract(std::prev(object.end()));
+                node.mapped().recycle(scratch);
+                node.key().clear();
+                scratch.strings.push_back(std::move(node.key()));
+                scratch.members.push_back(std::move(node));
+            }
+        } break;
+        default:
+            break;
+    }
+    clear();
+    type_ = TYPE_NULL;
+}
+
+const JSON JSON::SKIP;
+
+// how a value is decoded for the projection that selects it, false skips the value, an object
+// keeps only the listed members, anything else keeps the whole value
+const JSON* JSON::project(const JSON& selected) {
+    if (selected.type_ == TYPE_BOOL && !selected.as_bool_)
+        return &SKIP;
+    return selected.type_ == TYPE_OBJECT ? &selected : nullptr;
+}
+
+void JSON::invalid_literal() {
+    assert(false && "invalid JSON literal");
+}
+
+void JSON::inexact_literal() {
+    assert(false && "JSON literal number can't be converted exactly");
+}
+
+JSON JSON::Static::to_json() const {
+    switch (type()) {
+        case TYPE_NULL:
+            return nullptr;
+        case TYPE_BOOL:
+            return get_bool();
+        case TYPE_INT64:
+            return get_int64();
+        case TYPE_DOUBLE:
+            return get_double();
+        case TYPE_STRING:
+            return std::string{get_string()};
+        case TYPE_ARRAY: {
+            JSON json = array();
+            std::vector<JSON>& array = json.elements();
+            array.reserve(size());
+            std::uint32_t node = idx_ + 1;
+            for (std::uint32_t i = 0; i < nodes_[idx_].size; ++i) {
+                array.emplace_back(Static{nodes_, chars_, node}.to_json());
+                node = nodes_[node].next;
+            }
+            return json;
+        }
+        case TYPE_OBJECT: {
+            JSON json = object();
+            std::map<std::string, JSON, std::less<>>& object = json.members();
+            std::uint32_t node = idx_ + 1;
+            for (std::uint32_t i = 0; i < nodes_[idx_].size; ++i) {
+                object.emplace(std::string{chars_ + nodes_[node].offset, nodes_[node].size},
+                               Static{nodes_, chars_, node + 1}.to_json());
+                node = nodes_[node + 1].next;
+            }
+            return json;
+        }
+        default:
+            assert(false);
+            return nullptr;
+    }
+}
+
+JSON::Status JSON::scan(const char*& start,
+                        const char* end,
+                        [[maybe_unused]] int& ctx,
+                        [[maybe_unused]] std::size_t depth) {
+    assert(start <= end);
+
+    while (start < end) {
+        switch (*start) {
+            case ' ':  // whitespace
+            case '\n':
+            case '\r':
+            case '\t':
+                ++start;
+                break;
+
+            case '/': {  // comment
+                ++start;
+#ifdef JSON_STRICT
+                if (*start++ != '/')
+                    return INVALID_TOKEN;
+#endif  // JSON_STRICT
+                while (*start != '\n' && start < end)
+                    ++start;
+            } break;
+
+            case ',': {  // array or object
+                ++start;
+#ifdef JSON_STRICT
+                if ((ctx & CTX_COMMA) == 0)
+                    return UNEXPECTED_COMMA;
+                ctx &= ~CTX_COMMA;
+#endif  // JSON_STRICT
+            } break;
+
+            case ':': {  // object
+                ++start;
+#ifdef JSON_STRICT
+                if ((ctx & CTX_COLON) == 0)
+                    return UNEXPECTED_COLON;
+                ctx &= ~CTX_COLON;
+#endif  // JSON_STRICT
+            } break;
+
+            default:
+                return SUCCESS;
+        }
+    }
+
+#ifdef JSON_STRICT
+    if (depth > 0)
+        return UNEXPECTED_END;
+#endif  // JSON_STRICT
+    return END;
+}
+
+JSON::Status JSON::decode(const std::string& src,
+                          const JSON* projection,
+                          const Rule* rule,
+                          Decoder& decoder) {
+#ifdef JSON_STATS
+    Stats stats;
+    if (stats_callback())
+        decoder.stats = &stats;
+    auto started = std::chrono::steady_clock::now();
+#endif  // JSON_STATS
+    Scratch scratch;
+    if (decoder.scratch == nullptr)
+        decoder.scratch = &scratch;
+    const char* start = src.data();
+    const char* end = src.data() + src.size();
+    Status s1 = decode(start, end, 0, 0, projection, rule, &decoder);
+    decoder.scratch->elements.clear();  // left by the arrays that failed
+#ifdef JSON_STRICT
+    if (s1 == SUCCESS) {
+        int ctx = 0;
+        Status s2 = scan(start, end, ctx, 0);
+        if (s2 != END)
+            s1 = TRAILING_CONTENT;
+    }
+#endif  // JSON_STRICT
+    if (s1 == SUCCESS && rule != nullptr)
+        s1 = validate(*rule);
+#ifdef JSON_STATS
+    if (decoder.stats != nullptr) {
+        if (s1 == SUCCESS)
+            count(stats, 0);
+        stats.status = s1;
+        stats.bytes = src.size();
+        stats.ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now() - started)
+                       .count();
+        stats_callback()(stats);
+    }
+#endif  // JSON_STATS
+    return s1;
 }
 
-JSON::Status JSON::decode(const char*& start, const char* end, int ctx, std::size_t depth) {
+JSON::Status JSON::decode(const char*& start,
+                          const char* end,
+                          int ctx,
+                          std::size_t depth,
+                          const JSON* projection,
+                          const Rule* rule,
+                          Decoder* decoder) {
     assert(start <= end);
 
     if (depth > JSON_MAX_DEPTH)
         return DEPTH_EXCEEDED;
 
-    enum {  // ctx, represents where we are and what to expect
-        CTX_OBJECT = 1 << 1,
-        CTX_ARRAY = 1 << 2,
-        CTX_KEY = 1 << 3,
-        CTX_COLON = 1 << 4,
-        CTX_COMMA = 1 << 5,
-    };
+    // scalars are assigned in place, so release the previous value first
+    Scratch* scratch = decoder != nullptr ? decoder->scratch : nullptr;
+    if (scratch != nullptr)
+        recycle(*scratch);
+    clear();
+    type_ = TYPE_NULL;
+
+    // projection is nullptr to keep the whole value, an object to keep only the listed members,
+    // or SKIP to validate the value without materializing it
+    bool skip = projection == &SKIP;
+    const Limits* limits = decoder != nullptr ? decoder->limits : nullptr;
 
     int sign = +1;
     while (start < end) {
@@ -553,21 +4125,71 @@ JSON::Status JSON::decode(const char*& start, const char* end, int ctx, std::siz
                 if (ctx & (CTX_KEY | CTX_COLON | CTX_COMMA))
                     return UNEXPECTED_OBJECT;
 #endif  // JSON_STRICT
+                if (rule != nullptr && rule->types != 0 && (rule->types & 1 << TYPE_OBJECT) == 0)
+                    return SCHEMA_TYPE;  // reject before building the members
                 init_object();
                 ctx = CTX_OBJECT | CTX_KEY;
                 JSON key, value;
-                for (;;) {
-                    Status status = key.decode(start, end, ctx, depth + 1);
+                Decoder keys;  // keys aren't validated or counted, but reuse storage
+                keys.scratch = scratch;
+                keys.limits = limits;
+                for (std::size_t idx = 0;; ++idx) {
+                    keys.bytes = limits != nullptr ? decoder->bytes : 0;
+                    Status status = key.decode(start, end, ctx, depth + 1,
+                                               skip ? &SKIP : nullptr, nullptr, &keys);
                     if (status == END)
                         return SUCCESS;
                     if (status != SUCCESS)
                         return status;
                     if (key.type() != TYPE_STRING)
                         return INVALID_KEY_TYPE;
-                    status = value.decode(start, end, CTX_COLON, depth + 1);
-                    if (status != SUCCESS)
+                    const JSON* member = projection;
+                    if (projection != nullptr && !skip) {
+                        const JSON* selected = projection->find(key.as_string_);
+                        member = selected != nullptr ? project(*selected) : &SKIP;
+                    }
+                    const Rule* property = nullptr;
+                    if (rule != nullptr && member != &SKIP) {
+                        auto it = rule->properties.find(key.as_string_);
+                        if (it != rule->properties.end())
+                            property = it->second;
+                    }
+                    status =
+                        value.decode(start, end, CTX_COLON, depth + 1, member, property, decoder);
+                    if (status == SUCCESS && property != nullptr)
+                        status = value.validate(*property);
+                    if (status != SUCCESS) {
+                        failed(decoder, status, key.as_string_);
                         return status;
-                    as_object_.emplace(std::move(key.as_string_), std::move(value));
+                    }
+                    if (member != &SKIP && limits != nullptr) {
+                        if (limits->max_elements != 0 && idx >= limits->max_elements)
+                            return ELEMENTS_EXCEEDED;
+                        // a tree node per member, the header is a color and three pointers
+                        status = charge(decoder, 1,
+                                        sizeof(std::pair<const std::string, JSON>) +
+                                            4 * sizeof(void*) + key.as_string_.size());
+                        if (status != SUCCESS)
+                            return status;
+                    }
+                    if (member != &SKIP) {
+#ifdef JSON_STATS
+                        if (decoder != nullptr && decoder->stats != nullptr) {
+                            stats_string(*decoder->stats, key.as_string_);
+                            value.count(*decoder->stats, depth + 1);
+                        }
+#endif  // JSON_STATS
+                        if (scratch != nullptr && !scratch->members.empty()) {
+                            auto node = take(scratch->members);
+                            node.key() = std::move(key.as_string_);
+                            node.mapped() = std::move(value);
+                            members().insert(std::move(node));
+                        } else {
+                            members().emplace(std::move(key.as_string_), std::move(value));
+                        }
+                        key.clear();  // moved, so that it isn't recycled on the next key
+                        key.type_ = TYPE_NULL;
+                    }
                     ctx = CTX_OBJECT | CTX_KEY | CTX_COMMA;
                 }
             } break;
@@ -585,16 +4207,59 @@ JSON::Status JSON::decode(const char*& start, const char* end, int ctx, std::siz
                 if (ctx & (CTX_KEY | CTX_COLON | CTX_COMMA))
                     return UNEXPECTED_ARRAY;
 #endif  // JSON_STRICT
-                init_array();
+                if (rule != nullptr && rule->types != 0 && (rule->types & 1 << TYPE_ARRAY) == 0)
+                    return SCHEMA_TYPE;
+                init_array(scratch);
                 ctx = CTX_ARRAY;
                 JSON value;
-                for (;;) {
-                    Status status = value.decode(start, end, ctx, depth + 1);
-                    if (status == END)
+                const Rule* items = rule != nullptr && !skip ? rule->items : nullptr;
+                // elements are collected in the scratch and moved to the array at the end,
+                // so that it's allocated once with the exact size instead of growing
+                std::size_t first = scratch != nullptr ? scratch->elements.size() : 0;
+                for (std::size_t idx = 0;; ++idx) {
+                    Status status =
+                        value.decode(start, end, ctx, depth + 1, projection, items, decoder);
+                    if (status == END) {
+                        if (scratch != nullptr) {
+                            auto it = scratch->elements.begin() + first;
+#ifdef JSON_PACKED_ARRAYS
+                            if (Packed* packed = pack({it, scratch->elements.end()})) {
+                                clear();
+                                as_packed_ = packed;
+                                packed_ = true;
+                            }
+                            if (!packed_)
+#endif  // JSON_PACKED_ARRAYS
+                                elements().assign(
+                                    std::make_move_iterator(it),
+                                    std::make_move_iterator(scratch->elements.end()));
+                            scratch->elements.erase(it, scratch->elements.end());
+                        }
                         return SUCCESS;
-                    if (status != SUCCESS)
+                    }
+                    if (status == SUCCESS && items != nullptr)
+                        status = value.validate(*items);
+                    if (status != SUCCESS) {
+                        failed(decoder, status, std::to_string(idx));
                         return status;
-                    as_array_.emplace_back(std::move(value));
+                    }
+                    if (!skip && limits != nullptr) {
+                        if (limits->max_elements != 0 && idx >= limits->max_elements)
+                            return ELEMENTS_EXCEEDED;
+                        status = charge(decoder, 1, sizeof(JSON));
+                        if (status != SUCCESS)
+                            return status;
+                    }
+                    if (!skip) {
+#ifdef JSON_STATS
+                        if (decoder != nullptr && decoder->stats != nullptr)
+                            value.count(*decoder->stats, depth + 1);
+#endif  // JSON_STATS
+                        if (scratch != nullptr)
+                            scratch->elements.emplace_back(std::move(value));
+                        else
+                            elements().emplace_back(std::move(value));
+                    }
                     ctx = CTX_ARRAY | CTX_COMMA;
                 }
             } break;
@@ -628,43 +4293,86 @@ JSON::Status JSON::decode(const char*& start, const char* end, int ctx, std::siz
                 if (ctx & (CTX_COLON | CTX_COMMA))
                     return UNEXPECTED_STRING;
 #endif  // JSON_STRICT
-                init_string();
-                while (start < end) {
+                init_string(scratch);
+                for (;;) {
+                    const char* run = start;
+                    start = string_run(start, end);
+                    if (!skip) {
+                        Status status = fits(decoder, as_string_.size() + (start - run));
+                        if (status != SUCCESS)
+                            return status;
+                        as_string_.append(run, start - run);
+                    }
+                    if (start == end)
+                        return UNEXPECTED_STRING_END;
                     switch (*start++) {
                         case '"':  // end
-                            return SUCCESS;
+                            return skip ? SUCCESS : charge(decoder, 0, as_string_.size());
                         case '\\': {  // escape
+                            if (start == end)
+                                return UNEXPECTED_STRING_END;
+                            char buf[4];
+                            std::size_t length = 1;
                             switch (*start++) {
                                 case '"':
                                 case '\\':
                                 case '/': {
-                                    as_string_ += *(start - 1);
+                                    buf[0] = *(start - 1);
                                 } break;
                                 case 'b': {
-                                    as_string_ += '\b';
+                                    buf[0] = '\b';
                                 } break;
                                 case 'f': {
-                                    as_string_ += '\f';
+                                    buf[0] = '\f';
                                 } break;
                                 case 'n': {
-                                    as_string_ += '\n';
+                                    buf[0] = '\n';
                                 } break;
                                 case 'r': {
-                                    as_string_ += '\r';
+                                    buf[0] = '\r';
                                 } break;
                                 case 't': {
-                                    as_string_ += '\t';
+                                    buf[0] = '\t';
+                                } break;
+                                case 'u': {
+                                    std::uint32_t code;
+                                    if (!unescape(start, end, code))
+                                        return INVALID_STRING_ESCAPE;
+                                    if (code >= 0xD800 && code <= 0xDFFF) {  // unpaired surrogate
+#ifdef JSON_VALIDATE_UTF8
+                                        return INVALID_UTF8;
+#else   // JSON_VALIDATE_UTF8
+                                        code = 0xFFFD;  // replacement character
+#endif  // JSON_VALIDATE_UTF8
+                                    }
+                                    length = utf8_encode(buf, code);
                                 } break;
                                 default:
                                     return INVALID_STRING_ESCAPE;
                             }
+                            if (!skip) {
+                                Status status = fits(decoder, as_string_.size() + length);
+                                if (status != SUCCESS)
+                                    return status;
+                                as_string_.append(buf, length);
+                            }
                         } break;
-                        default: {
-                            as_string_ += *(start - 1);
+                        default: {  // non-ASCII, string_run() only stops here when validating
+#ifdef JSON_VALIDATE_UTF8
+                            std::size_t length = utf8_length(start - 1, end);
+                            if (length == 0)
+                                return INVALID_UTF8;
+                            if (!skip) {
+                                Status status = fits(decoder, as_string_.size() + length);
+                                if (status != SUCCESS)
+                                    return status;
+                                as_string_.append(start - 1, length);
+                            }
+                            start += length - 1;
+#endif  // JSON_VALIDATE_UTF8
                         } break;
                     }
                 }
-                return UNEXPECTED_STRING_END;
             } break;
 
             case 't': {  // true
@@ -725,11 +4433,15 @@ JSON::Status JSON::decode(const char*& start, const char* end, int ctx, std::siz
                 if (std::isdigit(*start))
                     return INVALID_NUMBER;
 #endif  // JSON_STRICT
+#ifdef JSON_RAW_NUMBERS
+                goto decode_raw;
+#else   // JSON_RAW_NUMBERS
                 if (*start == '.' || *start == 'e' || *start == 'E')
                     goto decode_double;
                 type_ = TYPE_INT64;
                 as_int64_ = 0;
                 return SUCCESS;
+#endif  // JSON_RAW_NUMBERS
             } break;
 
             case '1':  // int64
@@ -745,6 +4457,9 @@ JSON::Status JSON::decode(const char*& start, const char* end, int ctx, std::siz
                 if (ctx & (CTX_KEY | CTX_COLON | CTX_COMMA))
                     return UNEXPECTED_NUMBER;
 #endif  // JSON_STRICT
+#ifdef JSON_RAW_NUMBERS
+                goto decode_raw;
+#endif  // JSON_RAW_NUMBERS
                 for (const char* c = start; c < end; ++c) {
                     if (*c == '.' || *c == 'e' || *c == 'E')
                         goto decode_double;
@@ -778,19 +4493,282 @@ JSON::Status JSON::decode(const char*& start, const char* end, int ctx, std::siz
                 return SUCCESS;
             } break;
 
-            default:
-                return INVALID_TOKEN;
+#ifdef JSON_RAW_NUMBERS
+            decode_raw: {  // number text, converted on the first access
+                if (skip) {
+                    start = number_end(start - 1, end);
+                    return SUCCESS;
+                }
+                const char* first = start - 1;
+                start = number_end(first, end);
+                bool integer = true;
+                for (const char* c = first; c < start; ++c) {
+                    integer = integer && *c >= '0' && *c <= '9';
+                    if (*c == '.' && (c + 1 == start || c[1] < '0' || c[1] > '9')) {
+                        // "1." isn't valid JSON, so it can't be emitted verbatim
+                        type_ = TYPE_DOUBLE;
+                        as_double_ = std::strtod(first, nullptr) * sign;
+                        return SUCCESS;
+                    }
+                }
+                Status status = fits(decoder, start - first + 1);  // before allocating the text
+                if (status != SUCCESS)
+                    return status;
+                type_ = integer ? TYPE_INT64 : TYPE_DOUBLE;
+                new (&as_raw_) Raw{};
+                raw_ = true;
+                as_raw_.text.reserve(start - first + 1);
+                if (sign < 0)
+                    as_raw_.text += '-';
+                as_raw_.text.append(first, start - first);
+                return charge(decoder, 0, as_raw_.text.size());
+            } break;
+#endif  // JSON_RAW_NUMBERS
+
+            default:
+                return INVALID_TOKEN;
+        }
+    }
+
+#ifdef JSON_STRICT
+    if (depth > 0)
+        return UNEXPECTED_END;
+#endif  // JSON_STRICT
+    return END;
+}
+
+#ifdef JSON_STATS
+void JSON::set_stats_callback(std::function<void(const Stats&)> callback) {
+    stats_callback() = std::move(callback);
+}
+
+std::function<void(const JSON::Stats&)>& JSON::stats_callback() {
+    static std::function<void(const Stats&)> callback;
+    return callback;
+}
+
+void JSON::count(Stats& stats, std::size_t depth) const {
+    ++stats.nodes[type_];
+    stats.max_depth = depth > stats.max_depth ? depth : stats.max_depth;
+    switch (type_) {
+        case TYPE_STRING: {
+            stats_string(stats, as_string_);
+        } break;
+        case TYPE_ARRAY: {
+#ifdef JSON_PACKED_ARRAYS
+            if (packed_) {
+                stats.allocations += 2;  // the packed storage and its vector
+                stats.allocated_bytes += sizeof(Packed) + size() * sizeof(double);
+                break;
+            }
+#endif  // JSON_PACKED_ARRAYS
+#ifdef JSON_COW
+            ++stats.allocations;
+            stats.allocated_bytes += sizeof(*as_array_);
+#endif  // JSON_COW
+            stats_growth(stats, elements().size(), 0, sizeof(JSON));
+        } break;
+        case TYPE_OBJECT: {
+#ifdef JSON_COW
+            ++stats.allocations;
+            stats.allocated_bytes += sizeof(*as_object_);
+#endif  // JSON_COW
+            // a tree node per member, the header is a color and three pointers
+            std::size_t node = sizeof(std::pair<const std::string, JSON>) + 4 * sizeof(void*);
+            stats.allocations += members().size();
+            stats.allocated_bytes += members().size() * node;
+        } break;
+        default:
+            break;
+    }
+}
+
+void JSON::collect(Stats& stats, std::size_t depth) const {
+    count(stats, depth);
+    if (type_ == TYPE_ARRAY) {
+        each_element([&](const JSON& value) { value.collect(stats, depth + 1); });
+    } else if (type_ == TYPE_OBJECT) {
+        for (const auto& [key, value] : members()) {
+            stats_string(stats, key);
+            value.collect(stats, depth + 1);
         }
     }
+}
+#endif  // JSON_STATS
 
-#ifdef JSON_STRICT
-    if (depth > 0)
-        return UNEXPECTED_END;
-#endif  // JSON_STRICT
-    return END;
+JSON::Status JSON::validate(const Rule& rule) const {
+    if (rule.types != 0 && (rule.types & 1 << type_) == 0)
+        return SCHEMA_TYPE;
+
+    if (!rule.values.empty()) {
+        bool found = false;
+        for (const JSON& value : rule.values)
+            found = found || *this == value;
+        if (!found)
+            return SCHEMA_ENUM;
+    }
+
+    switch (type_) {
+        case TYPE_INT64:
+        case TYPE_DOUBLE: {
+            double number = get_double();
+            if ((rule.minimum && number < *rule.minimum) ||
+                (rule.maximum && number > *rule.maximum))
+                return SCHEMA_RANGE;
+        } break;
+        case TYPE_STRING: {
+            std::size_t length = 0;
+            for (char c : as_string_)
+                length += (c & 0xC0) != 0x80;  // skip utf-8 continuation bytes
+            if (length < rule.min_length || length > rule.max_length)
+                return SCHEMA_RANGE;
+        } break;
+        case TYPE_ARRAY: {
+            std::size_t length = size();
+            if (length < rule.min_items || length > rule.max_items)
+                return SCHEMA_RANGE;
+        } break;
+        case TYPE_OBJECT: {
+            for (const std::string& key : rule.required) {
+                if (members().find(key) == members().end())
+                    return SCHEMA_REQUIRED;
+            }
+        } break;
+        default:
+            break;
+    }
+
+    return SUCCESS;
+}
+
+JSON::Status JSON::charge(Decoder* decoder, std::size_t nodes, std::size_t bytes) {
+    if (decoder == nullptr || decoder->limits == nullptr)
+        return SUCCESS;
+    const Limits& limits = *decoder->limits;
+    decoder->nodes += nodes;
+    decoder->bytes += bytes;
+    if (limits.max_nodes != 0 && decoder->nodes > limits.max_nodes)
+        return NODES_EXCEEDED;
+    if (limits.max_bytes != 0 && decoder->bytes > limits.max_bytes)
+        return BYTES_EXCEEDED;
+    return SUCCESS;
+}
+
+// whether a string can grow to the length, checked before appending to it
+JSON::Status JSON::fits(const Decoder* decoder, std::size_t length) {
+    if (decoder == nullptr || decoder->limits == nullptr)
+        return SUCCESS;
+    const Limits& limits = *decoder->limits;
+    if (limits.max_string_length != 0 && length > limits.max_string_length)
+        return STRING_LENGTH_EXCEEDED;
+    if (limits.max_bytes != 0 && decoder->bytes + length > limits.max_bytes)
+        return BYTES_EXCEEDED;
+    return SUCCESS;
+}
+
+void JSON::failed(Decoder* decoder, Status status, std::string_view segment) {
+    if (decoder == nullptr || decoder->path == nullptr)
+        return;
+    if (status < SCHEMA_ENUM || status > SCHEMA_TYPE)
+        return;
+
+    // unwinding goes from the failed value to the root, so segments are prepended
+    std::string prefix = "/";
+    pointer_escape(prefix, segment);
+    decoder->path->insert(0, prefix);
+}
+
+bool JSON::Schema::compile(const JSON& schema, Status* status) {
+    rules_.clear();
+    root_ = add(schema);
+    if (status != nullptr)
+        *status = root_ != nullptr ? SUCCESS : INVALID_SCHEMA;
+    return root_ != nullptr;
+}
+
+const JSON::Rule* JSON::Schema::add(const JSON& schema) {
+    if (!schema.is_object())
+        return nullptr;
+
+    auto type_bits = [](const JSON& name) {
+        std::string_view string = name.get_string();
+        if (string == "null")
+            return 1 << TYPE_NULL;
+        if (string == "boolean")
+            return 1 << TYPE_BOOL;
+        if (string == "integer")
+            return 1 << TYPE_INT64;
+        if (string == "number")
+            return 1 << TYPE_INT64 | 1 << TYPE_DOUBLE;
+        if (string == "string")
+            return 1 << TYPE_STRING;
+        if (string == "array")
+            return 1 << TYPE_ARRAY;
+        if (string == "object")
+            return 1 << TYPE_OBJECT;
+        return 0;
+    };
+
+    auto size = [](const JSON& value, std::size_t& dst) {
+        if (!value.is_int64() || value.get_int64() < 0)
+            return false;
+        dst = value.get_int64();
+        return true;
+    };
+
+    Rule& rule = rules_.emplace_back();
+    for (const auto& [keyword, value] : schema.members()) {
+        bool valid = true;
+        if (keyword == "type") {
+            if (value.is_array()) {
+                for (const JSON& name : value.elements()) {
+                    int bits = type_bits(name);
+                    valid = valid && bits != 0;
+                    rule.types |= bits;
+                }
+            } else {
+                rule.types = type_bits(value);
+                valid = rule.types != 0;
+            }
+        } else if (keyword == "properties") {
+            valid = value.is_object();
+            for (const auto& [key, property] : value.get_object()) {
+                const Rule* child = add(property);
+                valid = valid && child != nullptr;
+                rule.properties.emplace(key, child);
+            }
+        } else if (keyword == "items") {
+            rule.items = add(value);
+            valid = rule.items != nullptr;
+        } else if (keyword == "required") {
+            valid = value.is_array();
+            for (const JSON& key : value.get_array()) {
+                valid = valid && key.is_string();
+                rule.required.push_back(key.get_string());
+            }
+        } else if (keyword == "minimum" || keyword == "maximum") {
+            valid = value.is_int64() || value.is_double();
+            (keyword == "minimum" ? rule.minimum : rule.maximum) = value.get_double();
+        } else if (keyword == "minLength") {
+            valid = size(value, rule.min_length);
+        } else if (keyword == "maxLength") {
+            valid = size(value, rule.max_length);
+        } else if (keyword == "minItems") {
+            valid = size(value, rule.min_items);
+        } else if (keyword == "maxItems") {
+            valid = size(value, rule.max_items);
+        } else if (keyword == "enum") {
+            valid = value.is_array();
+            rule.values = value.get_array();
+        }  // other keywords are ignored
+        if (!valid)
+            return nullptr;
+    }
+
+    return &rule;
 }
 
-void JSON::encode(std::string& dst, bool pretty, int indent) const {
+void JSON::encode(std::string& dst, bool pretty, int indent, bool ascii) const {
     switch (type_) {
         case TYPE_NULL: {
             dst += "null";
@@ -799,27 +4777,49 @@ void JSON::encode(std::string& dst, bool pretty, int indent) const {
             dst += as_bool_ ? "true" : "false";
         } break;
         case TYPE_INT64: {
+#ifdef JSON_RAW_NUMBERS
+            if (raw_) {
+                dst += as_raw_.text;
+                break;
+            }
+#endif  // JSON_RAW_NUMBERS
             char buf[64];
             std::to_chars_result result = std::to_chars(buf, buf + sizeof(buf), as_int64_);
             dst.append(buf, result.ptr);
         } break;
         case TYPE_DOUBLE: {
+#ifdef JSON_RAW_NUMBERS
+            if (raw_) {
+                dst += as_raw_.text;
+                break;
+            }
+#endif  // JSON_RAW_NUMBERS
             char buf[128];
             std::to_chars_result result = std::to_chars(buf, buf + sizeof(buf), as_double_);
             dst.append(buf, result.ptr);
         } break;
         case TYPE_STRING: {
-            string_escape(dst, as_string_);
+            string_escape(dst, as_string_, ascii);
         } break;
         case TYPE_ARRAY: {
+#ifdef JSON_PACKED_ARRAYS
+            if (packed_) {
+                if (as_packed_->type == TYPE_INT64)
+                    encode_numbers(dst, get_int64s(), pretty, indent);
+                else
+                    encode_numbers(dst, get_doubles(), pretty, indent);
+                break;
+            }
+#endif  // JSON_PACKED_ARRAYS
+            const std::vector<JSON>& array = elements();
             dst += pretty ? "[\n" : "[";
-            for (auto it = as_array_.begin(); it != as_array_.end(); ++it) {
+            for (auto it = array.begin(); it != array.end(); ++it) {
                 if (pretty) {
                     for (int i = 0; i < indent; ++i)
                         dst += "  ";
                 }
-                it->encode(dst, pretty, indent + 1);
-                if (std::next(it) != as_array_.end())
+                it->encode(dst, pretty, indent + 1, ascii);
+                if (std::next(it) != array.end())
                     dst += ',';
                 if (pretty)
                     dst += '\n';
@@ -831,16 +4831,17 @@ void JSON::encode(std::string& dst, bool pretty, int indent) const {
             dst += ']';
         } break;
         case TYPE_OBJECT: {
+            const std::map<std::string, JSON, std::less<>>& object = members();
             dst += pretty ? "{\n" : "{";
-            for (auto it = as_object_.begin(); it != as_object_.end(); ++it) {
+            for (auto it = object.begin(); it != object.end(); ++it) {
                 if (pretty) {
                     for (int i = 0; i < indent; ++i)
                         dst += "  ";
                 }
-                string_escape(dst, it->first);
+                string_escape(dst, it->first, ascii);
                 dst += pretty ? ": " : ":";
-                it->second.encode(dst, pretty, indent + 1);
-                if (std::next(it) != as_object_.end())
+                it->second.encode(dst, pretty, indent + 1, ascii);
+                if (std::next(it) != object.end())
                     dst += ',';
                 if (pretty)
                     dst += '\n';
@@ -857,10 +4858,680 @@ void JSON::encode(std::string& dst, bool pretty, int indent) const {
     }
 }
 
-static void string_escape(std::string& dst, const std::string& src) {
+std::string JSON::minify(std::string_view src, Status* status) {
+    std::string string;
+    Status s1 = reformat(src, string, false, 0);
+    if (s1 != SUCCESS)
+        string.clear();
+    if (status != nullptr)
+        *status = s1;
+    return string;
+}
+
+std::string JSON::prettify(std::string_view src, int indent, Status* status) {
+    std::string string;
+    Status s1 = reformat(src, string, true, indent > 0 ? indent : 0);
+    if (s1 != SUCCESS)
+        string.clear();
+    if (status != nullptr)
+        *status = s1;
+    return string;
+}
+
+// one pass over the tokens with the checks of decode(), strings and valid numbers are copied
+// as they are and separators are written again, formatted like dump()
+JSON::Status JSON::reformat(std::string_view src, std::string& dst, bool pretty, int indent) {
+    struct Level {
+        char close;  // ] or }
+        bool empty;  // nothing written yet
+        bool key;    // an object expects a key next
+    };
+    std::vector<Level> levels;
+    auto line = [&](std::size_t depth) {
+        if (pretty) {
+            dst += '\n';
+            dst.append(depth * indent, ' ');
+        }
+    };
+
+    dst.reserve(src.size());
+    const char* start = src.data();
+    const char* end = src.data() + src.size();
+    int ctx = 0;
+    for (;;) {
+        Status status = scan(start, end, ctx, levels.size());
+        if (status == END && !levels.empty()) {
+            if (levels.back().close == '}' && !levels.back().key)
+                return END;  // the member has no value
+            while (!levels.empty()) {  // unclosed containers end with the text when not strict
+                line(levels.size() - 1);
+                dst += levels.back().close;
+                levels.pop_back();
+            }
+            return SUCCESS;
+        }
+        if (status != SUCCESS)
+            return status;
+
+        char c = *start++;
+        if (c == ']' || c == '}') {
+#ifdef JSON_STRICT
+            if (c == ']' && (ctx & CTX_ARRAY) == 0)
+                return UNEXPECTED_ARRAY_END;
+            if (c == '}' && (ctx & CTX_OBJECT) == 0)
+                return UNEXPECTED_OBJECT_END;
+#endif  // JSON_STRICT
+            if (levels.empty() || (levels.back().close == '}' && !levels.back().key))
+                return END;
+            line(levels.size() - 1);
+            dst += levels.back().close;
+            levels.pop_back();
+        } else {
+            if (levels.size() > JSON_MAX_DEPTH)
+                return DEPTH_EXCEEDED;
+            bool key = !levels.empty() && levels.back().key;
+#ifdef JSON_STRICT
+            if (c == '"' ? (ctx & (CTX_COLON | CTX_COMMA)) != 0
+                         : (ctx & (CTX_KEY | CTX_COLON | CTX_COMMA)) != 0) {
+                if (c == '{')
+                    return UNEXPECTED_OBJECT;
+                if (c == '[')
+                    return UNEXPECTED_ARRAY;
+                if (c == '"')
+                    return UNEXPECTED_STRING;
+                return c == '-' || (c >= '0' && c <= '9') ? UNEXPECTED_NUMBER : UNEXPECTED_TOKEN;
+            }
+#endif  // JSON_STRICT
+            if (key && c != '"')
+                return INVALID_KEY_TYPE;
+
+            // separators before the value
+            if (!levels.empty()) {
+                Level& level = levels.back();
+                if (level.close == '}' && !level.key) {
+                    dst += pretty ? ": " : ":";
+                } else {
+                    if (!level.empty)
+                        dst += ',';
+                    line(levels.size());
+                    level.empty = false;
+                }
+                level.key = level.close == '}' && !level.key;
+            }
+
+            switch (c) {
+                case '{':
+                case '[': {
+                    dst += c;
+                    levels.push_back({c == '{' ? '}' : ']', true, c == '{'});
+                    ctx = c == '{' ? CTX_OBJECT | CTX_KEY : CTX_ARRAY;
+                    continue;
+                }
+                case '"': {
+                    const char* first = start - 1;
+                    for (;;) {
+                        start = string_run(start, end);
+                        if (start == end)
+                            return UNEXPECTED_STRING_END;
+                        char s = *start++;
+                        if (s == '"')
+                            break;
+                        if (s == '\\') {
+                            if (start == end)
+                                return UNEXPECTED_STRING_END;
+                            char e = *start++;
+                            if (e == 'u') {
+                                std::uint32_t code;
+                                if (!unescape(start, end, code))
+                                    return INVALID_STRING_ESCAPE;
+#ifdef JSON_VALIDATE_UTF8
+                                if (code >= 0xD800 && code <= 0xDFFF)
+                                    return INVALID_UTF8;
+#endif  // JSON_VALIDATE_UTF8
+                            } else if (std::strchr("\"\\/bfnrt", e) == nullptr || e == '\0') {
+                                return INVALID_STRING_ESCAPE;
+                            }
+                        } else {  // non-ASCII, string_run() only stops here when validating
+#ifdef JSON_VALIDATE_UTF8
+                            std::size_t length = utf8_length(start - 1, end);
+                            if (length == 0)
+                                return INVALID_UTF8;
+                            start += length - 1;
+#endif  // JSON_VALIDATE_UTF8
+                        }
+                    }
+                    dst.append(first, start - first);
+                    if (key) {
+                        ctx = CTX_COLON;
+                        continue;
+                    }
+                } break;
+                case 't':
+                case 'f':
+                case 'n': {
+                    const char* literal = c == 't' ? "true" : c == 'f' ? "false" : "null";
+                    std::size_t length = std::strlen(literal) - 1;
+#ifdef JSON_STRICT
+                    if (std::strncmp(start, literal + 1, length) != 0)
+                        return INVALID_TOKEN;
+#endif  // JSON_STRICT
+                    start = static_cast<std::size_t>(end - start) > length ? start + length : end;
+                    dst += literal;
+                } break;
+                default: {
+                    const char* first = start - 1;
+                    while (start < end && ((*start >= '0' && *start <= '9') || *start == '.' ||
+                                           *start == 'e' || *start == 'E' || *start == '+' ||
+                                           *start == '-'))
+                        ++start;
+                    if (number_valid(first, start)) {
+                        dst.append(first, start - first);
+                        break;
+                    }
+                    // anything else is read by decode(), and numbers it accepts, like "1." in
+                    // lenient mode, are written again so that the result is valid
+                    start = first;
+                    JSON number;
+                    status = number.decode(start, end, ctx, levels.size(), nullptr);
+                    if (status != SUCCESS)
+                        return status;
+                    number.encode(dst, false, 0);
+                } break;
+            }
+        }
+
+        if (levels.empty())
+            break;
+        ctx = levels.back().close == ']' ? CTX_ARRAY | CTX_COMMA
+                                         : CTX_OBJECT | CTX_KEY | CTX_COMMA;
+    }
+
+#ifdef JSON_STRICT
+    ctx = 0;
+    if (scan(start, end, ctx, 0) != END)
+        return TRAILING_CONTENT;
+#endif  // JSON_STRICT
+    return SUCCESS;
+}
+
+JSON::Status JSON::apply(JSON& op, std::vector<Undo>& undo) {
+    JSON* name = op.find("op");
+    JSON* path = op.find("path");
+    if (name == nullptr || !name->is_string() || path == nullptr || !path->is_string())
+        return INVALID_PATCH;
+
+    const std::string& kind = name->as_string_;
+    const std::string& dst = path->as_string_;
+    JSON value;
+    std::size_t moved = SIZE_MAX;  // entry of the value a move took out, if any
+    if (kind == "add" || kind == "replace" || kind == "test") {
+        JSON* v = op.find("value");
+        if (v == nullptr)
+            return INVALID_PATCH;
+        value = std::move(*v);
+    } else if (kind == "move" || kind == "copy") {
+        JSON* from = op.find("from");
+        if (from == nullptr || !from->is_string())
+            return INVALID_PATCH;
+        const std::string& src = from->as_string_;
+        if (kind == "move" && dst.size() > src.size() && dst.compare(0, src.size(), src) == 0 &&
+            dst[src.size()] == '/')
+            return INVALID_PATCH;  // can't move a value into its own child
+
+        std::string key;
+        JSON* parent = resolve(src, key, true);
+        if (parent == nullptr)
+            return INVALID_POINTER;
+        if (parent == this && src.empty()) {
+            if (kind == "move")
+                return SUCCESS;  // the document onto itself, anything else is its own child
+            value = *this;
+        } else if (parent->is_object()) {
+            std::map<std::string, JSON, std::less<>>& object = parent->members();
+            auto it = object.find(key);
+            if (it == object.end())
+                return PATH_NOT_FOUND;
+            if (kind == "move") {
+                value = std::move(it->second);
+                object.erase(it);
+                moved = undo.size();
+                undo.push_back({Undo::ERASED, src, {}});
+            } else {
+                value = it->second;
+            }
+        } else {
+            std::vector<JSON>& array = parent->elements();
+            std::size_t idx;
+            if (!pointer_index(key, array.size(), idx))
+                return PATH_NOT_FOUND;
+            if (kind == "move") {
+                value = std::move(array[idx]);
+                array.erase(array.begin() + idx);
+                moved = undo.size();
+                undo.push_back({Undo::ERASED, src, {}});
+            } else {
+                value = array[idx];
+            }
+        }
+    } else if (kind != "remove") {
+        return INVALID_PATCH;
+    }
+
+    Status status = place(kind, dst, value, undo);
+    if (moved != SIZE_MAX) {
+        if (status == SUCCESS)
+            undo[moved].kind = Undo::MOVED;  // the value is at dst now
+        else
+            undo[moved].value = std::move(value);
+    }
+    return status;
+}
+
+// the destination part of apply(), value is moved to the document only when the op succeeds
+JSON::Status JSON::place(const std::string& kind,
+                         const std::string& dst,
+                         JSON& value,
+                         std::vector<Undo>& undo) {
+    std::string key;
+    JSON* parent = resolve(dst, key, kind != "test");
+    if (parent == nullptr)
+        return kind == "test" ? PATH_NOT_FOUND : INVALID_POINTER;
+
+    if (kind == "test")
+        return *parent == value ? SUCCESS : TEST_FAILED;
+
+    if (dst.empty()) {  // whole document
+        undo.push_back({Undo::REPLACED, dst, std::move(*this)});
+        if (kind == "remove")
+            *this = nullptr;
+        else
+            *this = std::move(value);
+        return SUCCESS;
+    }
+
+    if (parent->is_object()) {
+        std::map<std::string, JSON, std::less<>>& object = parent->members();
+        auto it = object.find(key);
+        if (kind == "remove" || kind == "replace") {
+            if (it == object.end())
+                return PATH_NOT_FOUND;
+            if (kind == "remove") {
+                undo.push_back({Undo::ERASED, dst, std::move(it->second)});
+                object.erase(it);
+            } else {
+                undo.push_back({Undo::REPLACED, dst, std::move(it->second)});
+                it->second = std::move(value);
+            }
+        } else if (it != object.end()) {
+            undo.push_back({Undo::REPLACED, dst, std::move(it->second)});
+            it->second = std::move(value);
+        } else {
+            undo.push_back({Undo::INSERTED, dst, {}});
+            object.emplace(std::move(key), std::move(value));
+        }
+        return SUCCESS;
+    }
+
+    std::vector<JSON>& array = parent->elements();
+    bool insert = kind == "add" || kind == "move" || kind == "copy";
+    std::size_t idx;
+    if (insert && key == "-") {
+        idx = array.size();
+    } else if (!pointer_index(key, array.size() + (insert ? 1 : 0), idx)) {
+        return PATH_NOT_FOUND;
+    }
+    std::string at = dst.substr(0, dst.rfind('/') + 1) + std::to_string(idx);
+    if (insert) {
+        undo.push_back({Undo::INSERTED, std::move(at), {}});
+        array.emplace(array.begin() + idx, std::move(value));
+    } else if (kind == "remove") {
+        undo.push_back({Undo::ERASED, std::move(at), std::move(array[idx])});
+        array.erase(array.begin() + idx);
+    } else {
+        undo.push_back({Undo::REPLACED, std::move(at), std::move(array[idx])});
+        array[idx] = std::move(value);
+    }
+    return SUCCESS;
+}
+
+// reverts the changes newest first, so every path resolves to the value it was recorded for
+void JSON::rollback(std::vector<Undo>& undo) {
+    JSON carried;  // taken out by a reverted change, put back by the move it came from
+    for (auto it = undo.rbegin(); it != undo.rend(); ++it) {
+        std::string key;
+        JSON* parent = resolve(it->path, key, true);
+        assert(parent != nullptr);
+        if (it->path.empty()) {
+            carried = std::move(*this);
+            *this = std::move(it->value);
+        } else if (parent->is_object()) {
+            std::map<std::string, JSON, std::less<>>& object = parent->members();
+            auto found = object.find(key);
+            if (it->kind == Undo::INSERTED) {
+                carried = std::move(found->second);
+                object.erase(found);
+            } else if (it->kind == Undo::REPLACED) {
+                carried = std::move(found->second);
+                found->second = std::move(it->value);
+            } else {
+                object.emplace(std::move(key),
+                               std::move(it->kind == Undo::MOVED ? carried : it->value));
+            }
+        } else {
+            std::vector<JSON>& array = parent->elements();
+            std::size_t idx;
+            pointer_index(key, array.size() + 1, idx);
+            if (it->kind == Undo::INSERTED) {
+                carried = std::move(array[idx]);
+                array.erase(array.begin() + idx);
+            } else if (it->kind == Undo::REPLACED) {
+                carried = std::move(array[idx]);
+                array[idx] = std::move(it->value);
+            } else {
+                array.emplace(array.begin() + idx,
+                              std::move(it->kind == Undo::MOVED ? carried : it->value));
+            }
+        }
+    }
+}
+
+JSON* JSON::resolve(std::string_view path, std::string& key, bool parent) {
+    if (path.empty()) {
+        key.clear();
+        return this;
+    }
+    if (path[0] != '/')
+        return nullptr;
+
+    JSON* json = this;
+    for (;;) {
+        path.remove_prefix(1);
+        std::size_t n = path.find('/');
+        std::string_view token = path.substr(0, n);
+
+        key.clear();
+        for (std::size_t i = 0; i < token.size(); ++i) {
+            if (token[i] != '~') {
+                key += token[i];
+            } else if (i + 1 < token.size() && (token[i + 1] == '0' || token[i + 1] == '1')) {
+                key += token[++i] == '0' ? '~' : '/';
+            } else {
+                return nullptr;
+            }
+        }
+
+        if (n == std::string_view::npos && parent)
+            return json->is_object() || json->is_array() ? json : nullptr;
+
+        if (json->is_object()) {
+            json = json->find(key);
+        } else if (json->is_array()) {
+            std::size_t idx;
+            std::vector<JSON>& array = json->elements();
+            json = pointer_index(key, array.size(), idx) ? &array[idx] : nullptr;
+        } else {
+            json = nullptr;
+        }
+        if (json == nullptr || n == std::string_view::npos)
+            return json;
+        path.remove_prefix(n);
+    }
+}
+
+void JSON::diff(std::vector<JSON>& ops,
+                std::string& path,
+                const JSON& source,
+                const JSON& target) {
+    if (source.shares(target))
+        return;
+
+    std::size_t size = path.size();
+    if (source.type_ == TYPE_OBJECT && target.type_ == TYPE_OBJECT) {
+        const std::map<std::string, JSON, std::less<>>& a = source.members();
+        const std::map<std::string, JSON, std::less<>>& b = target.members();
+        auto it1 = a.begin();
+        auto it2 = b.begin();
+        while (it1 != a.end() || it2 != b.end()) {
+            int cmp = it1 == a.end()   ? 1
+                      : it2 == b.end() ? -1
+                                       : it1->first.compare(it2->first);
+            path += '/';
+            pointer_escape(path, cmp <= 0 ? it1->first : it2->first);
+            if (cmp < 0) {
+                ops.emplace_back(object({{"op", "remove"}, {"path", path}}));
+                ++it1;
+            } else if (cmp > 0) {
+                ops.emplace_back(object({{"op", "add"}, {"path", path}, {"value", it2->second}}));
+                ++it2;
+            } else {
+                diff(ops, path, it1->second, it2->second);
+                ++it1;
+                ++it2;
+            }
+            path.resize(size);
+        }
+    } else if (source.type_ == TYPE_ARRAY && target.type_ == TYPE_ARRAY) {
+        // equal elements at both ends are skipped, the rest is diffed by position, so an
+        // insert or a removal in the middle doesn't replace everything after it
+        auto equal = [&](std::size_t i, std::size_t j) {
+            return source.with_element(i, [&](const JSON& a) {
+                return target.with_element(j, [&](const JSON& b) { return a == b; });
+            });
+        };
+        std::size_t first = 0;
+        while (first < source.size() && first < target.size() && equal(first, first))
+            ++first;
+        std::size_t last_a = source.size();
+        std::size_t last_b = target.size();
+        while (last_a > first && last_b > first && equal(last_a - 1, last_b - 1)) {
+            --last_a;
+            --last_b;
+        }
+        std::size_t common = std::min(last_a, last_b);
+        for (std::size_t i = first; i < common; ++i) {
+            path += '/';
+            path += std::to_string(i);
+            source.with_element(i, [&](const JSON& a) {
+                target.with_element(i, [&](const JSON& b) { diff(ops, path, a, b); });
+            });
+            path.resize(size);
+        }
+        for (std::size_t i = last_a; i > common; --i) {  // from the back, the indices stay valid
+            path += '/';
+            path += std::to_string(i - 1);
+            ops.emplace_back(object({{"op", "remove"}, {"path", path}}));
+            path.resize(size);
+        }
+        for (std::size_t i = common; i < last_b; ++i) {
+            path += '/';
+            path += std::to_string(i);
+            target.with_element(i, [&](const JSON& b) {
+                ops.emplace_back(object({{"op", "add"}, {"path", path}, {"value", b}}));
+            });
+            path.resize(size);
+        }
+    } else if (source != target) {
+        ops.emplace_back(object({{"op", "replace"}, {"path", path}, {"value", target}}));
+    }
+}
+
+static void pointer_escape(std::string& dst, std::string_view src) {
+    for (char c : src) {
+        switch (c) {
+            case '~': {
+                dst += "~0";
+            } break;
+            case '/': {
+                dst += "~1";
+            } break;
+            default: {
+                dst += c;
+            } break;
+        }
+    }
+}
+
+static void path_space(const char*& p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+        ++p;
+}
+
+static bool path_name(const char*& p, const char* end, std::string& name) {
+    const char* first = p;
+    while (p < end && (std::isalnum(static_cast<unsigned char>(*p)) || *p == '_' ||
+                       static_cast<unsigned char>(*p) >= 0x80))
+        ++p;
+    name.assign(first, p - first);
+    return p > first;
+}
+
+static bool path_quoted(const char*& p, const char* end, std::string& string) {
+    char quote = *p++;
+    while (p < end && *p != quote) {
+        if (*p == '\\' && p + 1 < end)
+            ++p;
+        string += *p++;
+    }
+    return p < end && *p++ == quote;
+}
+
+static bool path_number(const char*& p, const char* end, std::int64_t& value) {
+    path_space(p, end);
+    std::from_chars_result result = std::from_chars(p, end, value);
+    if (result.ec != std::errc{})
+        return false;
+    p = result.ptr;
+    path_space(p, end);
+    return true;
+}
+
+// strict JSON number grammar: -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+static bool number_valid(const char* start, const char* end) {
+    auto digits = [&] {
+        const char* first = start;
+        while (start < end && *start >= '0' && *start <= '9')
+            ++start;
+        return start > first;
+    };
+    start += start < end && *start == '-';
+    if (start < end && *start == '0')
+        ++start;
+    else if (!digits())
+        return false;
+    if (start < end && *start == '.') {
+        ++start;
+        if (!digits())
+            return false;
+    }
+    if (start < end && (*start == 'e' || *start == 'E')) {
+        ++start;
+        start += start < end && (*start == '+' || *start == '-');
+        if (!digits())
+            return false;
+    }
+    return start == end;
+}
+
+static std::size_t string_memory(const std::string& string) {
+    static const std::size_t inline_capacity = std::string().capacity();
+    return string.capacity() > inline_capacity ? string.capacity() + 1 : 0;
+}
+
+static bool pointer_index(const std::string& key, std::size_t size, std::size_t& idx) {
+    if (key.empty() || (key[0] == '0' && key.size() > 1))
+        return false;
+    std::from_chars_result result = std::from_chars(key.data(), key.data() + key.size(), idx);
+    return result.ec == std::errc{} && result.ptr == key.data() + key.size() && idx < size;
+}
+
+#ifdef JSON_PACKED_ARRAYS
+// formats the array into space reserved for the longest numbers, then trims the rest
+template <class T>
+static void encode_numbers(std::string& dst, std::span<const T> values, bool pretty, int indent) {
+    std::size_t margin = pretty ? 2 * indent + 2 : 1;  // indentation, comma and newline
+    std::size_t size = dst.size();
+    dst.resize(size + 3 + 2 * indent + values.size() * (32 + margin));
+    char* out = dst.data() + size;
+    *out++ = '[';
+    if (pretty)
+        *out++ = '\n';
+    for (std::size_t i = 0; i < values.size(); ++i) {
+        if (pretty) {
+            std::memset(out, ' ', 2 * indent);
+            out += 2 * indent;
+        }
+        out = std::to_chars(out, out + 32, values[i]).ptr;
+        if (i + 1 < values.size())
+            *out++ = ',';
+        if (pretty)
+            *out++ = '\n';
+    }
+    if (pretty) {
+        std::memset(out, ' ', 2 * (indent - 1));
+        out += 2 * (indent - 1);
+    }
+    *out++ = ']';
+    dst.resize(out - dst.data());
+}
+#endif  // JSON_PACKED_ARRAYS
+
+template <class T>
+static T take(std::vector<T>& pool) {
+    T value = std::move(pool.back());
+    pool.pop_back();
+    return value;
+}
+
+static void hash_combine(std::size_t& seed, std::size_t hash) {
+    seed ^= hash + static_cast<std::size_t>(0x9e3779b97f4a7c15ULL) + (seed << 6) + (seed >> 2);
+}
+
+// integral doubles hash like int64, because they compare equal to it
+static std::size_t number_hash(double value) {
+    if (value >= -0x1p63 && value < 0x1p63 &&
+        static_cast<double>(static_cast<std::int64_t>(value)) == value)
+        return std::hash<std::int64_t>{}(static_cast<std::int64_t>(value));
+    return std::hash<double>{}(value);
+}
+
+#ifdef JSON_STATS
+// estimates allocations of a container grown one element at a time by doubling its capacity
+static void stats_growth(JSON::Stats& stats,
+                         std::size_t size,
+                         std::size_t capacity,
+                         std::size_t n) {
+    while (capacity < size) {
+        capacity = capacity > 0 ? capacity * 2 : 1;
+        ++stats.allocations;
+        stats.allocated_bytes += capacity * n;
+    }
+}
+
+static void stats_string(JSON::Stats& stats, const std::string& string) {
+    stats.string_bytes += string.size();
+    stats_growth(stats, string.size(), std::string().capacity(), 1);
+}
+#endif  // JSON_STATS
+
+void JSON::string_escape(std::string& dst, std::string_view src, bool ascii) {
+    static const char HEX[] = "0123456789abcdef";
+    auto escape_code = [&](std::uint32_t code) {
+        char buf[6] = {'\\', 'u', HEX[code >> 12 & 0xF], HEX[code >> 8 & 0xF],
+                       HEX[code >> 4 & 0xF], HEX[code & 0xF]};
+        dst.append(buf, sizeof(buf));
+    };
+
     dst.reserve(dst.size() + src.size());
     dst += "\"";
-    for (char c : src) {
+    const char* start = src.data();
+    const char* end = src.data() + src.size();
+    for (;;) {
+        const char* run = start;
+        start = escape_run(start, end, ascii);
+        dst.append(run, start - run);
+        if (start == end)
+            break;
+        char c = *start++;
         switch (c) {
             case '"': {
                 dst += "\\\"";
@@ -887,11 +5558,153 @@ static void string_escape(std::string& dst, const std::string& src) {
                 dst += "\\t";
             } break;
             default: {
-                dst += c;
+                if (static_cast<unsigned char>(c) < 0x20) {  // other control characters
+                    escape_code(static_cast<unsigned char>(c));
+                    break;
+                }
+                // non-ASCII in ascii mode, invalid sequences become replacement characters
+                std::size_t length = utf8_length(start - 1, end);
+                std::uint32_t code = 0xFFFD;
+                if (length > 0) {
+                    code = static_cast<unsigned char>(c) & (0x7F >> length);
+                    for (std::size_t i = 1; i < length; ++i)
+                        code = code << 6 | (static_cast<unsigned char>(*start++) & 0x3F);
+                }
+                if (code >= 0x10000) {  // surrogate pair
+                    escape_code(0xD800 + ((code - 0x10000) >> 10));
+                    escape_code(0xDC00 + ((code - 0x10000) & 0x3FF));
+                } else {
+                    escape_code(code);
+                }
             } break;
         }
     }
     dst += "\"";
 }
 
+#ifdef JSON_RAW_NUMBERS
+// integer texts without leading zeros, so a longer text is further from zero
+static std::partial_ordering integer_compare(std::string_view a, std::string_view b) {
+    bool negative1 = a[0] == '-';
+    bool negative2 = b[0] == '-';
+    if (negative1 != negative2)
+        return negative2 <=> negative1;
+    std::partial_ordering cmp = a.size() != b.size() ? a.size() <=> b.size() : a.compare(b) <=> 0;
+    return negative1 ? 0 <=> cmp : cmp;
+}
+
+// end of the number starting with a digit, accepts what strtoll() and strtod() accept
+static const char* number_end(const char* start, const char* end) {
+    auto digits = [&](const char* c) {
+        while (c < end && *c >= '0' && *c <= '9')
+            ++c;
+        return c;
+    };
+    start = *start == '0' ? start + 1 : digits(start);  // no leading zeros
+    if (start < end && *start == '.')
+        start = digits(start + 1);
+    if (start < end && (*start == 'e' || *start == 'E')) {
+        const char* exponent = start + 1;
+        if (exponent < end && (*exponent == '+' || *exponent == '-'))
+            ++exponent;
+        if (exponent < end && *exponent >= '0' && *exponent <= '9')
+            start = digits(exponent);
+    }
+    return start;
+}
+#endif  // JSON_RAW_NUMBERS
+
+// word-at-a-time scanning, each byte of the word is checked without branches
+static constexpr std::uint64_t SWAR_ONES = 0x0101010101010101;
+static constexpr std::uint64_t SWAR_HIGH = 0x8080808080808080;
+
+static std::uint64_t swar_load(const char* src) {
+    std::uint64_t word;
+    std::memcpy(&word, src, sizeof(word));
+    return word;
+}
+
+static std::uint64_t swar_equal(std::uint64_t word, char c) {  // high bit set if any byte is c
+    std::uint64_t x = word ^ (SWAR_ONES * static_cast<unsigned char>(c));
+    return (x - SWAR_ONES) & ~x & SWAR_HIGH;
+}
+
+// end of the run of characters that are copied as is when decoding a string
+static const char* string_run(const char* start, const char* end) {
+    for (; end - start >= 8; start += 8) {
+        std::uint64_t word = swar_load(start);
+        std::uint64_t found = swar_equal(word, '"') | swar_equal(word, '\\');
+#ifdef JSON_VALIDATE_UTF8
+        found |= word & SWAR_HIGH;
+#endif  // JSON_VALIDATE_UTF8
+        if (found != 0)
+            break;
+    }
+    for (; start < end; ++start) {
+        char c = *start;
+#ifdef JSON_VALIDATE_UTF8
+        if (c & 0x80)
+            break;
+#endif  // JSON_VALIDATE_UTF8
+        if (c == '"' || c == '\\')
+            break;
+    }
+    return start;
+}
+
+// end of the run of characters that are copied as is when encoding a string
+static const char* escape_run(const char* start, const char* end, bool ascii) {
+    std::uint64_t high = ascii ? SWAR_HIGH : 0;
+    for (; end - start >= 8; start += 8) {
+        std::uint64_t word = swar_load(start);
+        std::uint64_t control = (word - SWAR_ONES * 0x20) & ~word & SWAR_HIGH;
+        std::uint64_t found = swar_equal(word, '"') | swar_equal(word, '\\') |
+                              swar_equal(word, '/') | control | (word & high);
+        if (found != 0)
+            break;
+    }
+    for (; start < end; ++start) {
+        unsigned char c = *start;
+        if (c < 0x20 || c == '"' || c == '\\' || c == '/' || (ascii && c >= 0x80))
+            break;
+    }
+    return start;
+}
+
+// length of the well-formed UTF-8 sequence at start, 0 if it's invalid, overlong or a surrogate
+static std::size_t utf8_length(const char* start, const char* end) {
+    auto byte = [&](std::size_t i) -> unsigned char { return start[i]; };
+    unsigned char c = byte(0);
+    std::size_t length;
+    unsigned char lo = 0x80;
+    unsigned char hi = 0xBF;
+    if (c < 0x80)
+        return 1;
+    else if (c >= 0xC2 && c <= 0xDF)
+        length = 2;
+    else if (c >= 0xE0 && c <= 0xEF)
+        length = 3;
+    else if (c >= 0xF0 && c <= 0xF4)
+        length = 4;
+    else
+        return 0;
+    if (c == 0xE0)
+        lo = 0xA0;  // overlong
+    else if (c == 0xED)
+        hi = 0x9F;  // surrogates
+    else if (c == 0xF0)
+        lo = 0x90;  // overlong
+    else if (c == 0xF4)
+        hi = 0x8F;  // above U+10FFFF
+    if (end - start < static_cast<std::ptrdiff_t>(length))
+        return 0;
+    if (byte(1) < lo || byte(1) > hi)
+        return 0;
+    for (std::size_t i = 2; i < length; ++i) {
+        if (byte(i) < 0x80 || byte(i) > 0xBF)
+            return 0;
+    }
+    return length;
+}
+
 #endif  // JSON_IMPLEMENTATION
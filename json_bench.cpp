@@ -0,0 +1,281 @@
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+
+#define JSON_IMPLEMENTATION
+#include "json.hpp"
+
+#if defined(__GNUC__) && !defined(__clang__)
+// false positive when the replaced operators are inlined into library code
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif  // __GNUC__
+
+// allocation counters, updated by the replaced global operator new
+static std::atomic<std::size_t> allocations{0};
+static std::atomic<std::size_t> allocated_bytes{0};
+
+void* operator new(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size != 0 ? size : 1))
+        return ptr;
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+// deterministic corpora, the same bytes on every run and platform
+struct Random {
+    std::uint64_t state = 0x9E3779B97F4A7C15;
+
+    std::uint64_t next() {  // xorshift64
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+
+    int range(int lo, int hi) { return lo + static_cast<int>(next() % (hi - lo + 1)); }
+    double real(double lo, double hi) { return lo + (hi - lo) * (next() >> 11) * 0x1.0p-53; }
+    bool chance(int percent) { return range(0, 99) < percent; }
+};
+
+static std::string word(Random& random) {
+    static const char* WORDS[] = {
+        "json", "parse", "fast",  "value",   "array", "object", "string", "number", "tree",
+        "node", "query", "cache", "release", "build", "hello",  "world",  "status", "tweet",
+    };
+    return WORDS[random.range(0, sizeof(WORDS) / sizeof(*WORDS) - 1)];
+}
+
+static std::string sentence(Random& random, int words) {
+    std::string string;
+    for (int i = 0; i < words; ++i) {
+        if (i > 0)
+            string += ' ';
+        string += word(random);
+    }
+    return string;
+}
+
+// record-heavy, like twitter.json
+static std::string twitter(Random& random) {
+    JSON json;
+    JSON& statuses = json["statuses"] = JSON::array();
+    for (int i = 0; i < 2000; ++i) {
+        JSON status;
+        std::int64_t id = 505874924095815681 + i;
+        status["id"] = id;
+        status["id_str"] = std::to_string(id);
+        status["created_at"] = "Sun Aug 31 00:29:15 +0000 2014";
+        status["text"] = sentence(random, random.range(5, 20));
+        status["truncated"] = false;
+        status["in_reply_to_status_id"] = nullptr;
+        status["retweet_count"] = random.range(0, 1000);
+        status["favorite_count"] = random.range(0, 1000);
+        status["favorited"] = random.chance(10);
+        status["lang"] = "en";
+        JSON& user = status["user"];
+        user["id"] = random.range(1, 1 << 30);
+        user["name"] = word(random) + " " + word(random);
+        user["screen_name"] = word(random) + std::to_string(random.range(0, 999));
+        user["description"] = sentence(random, random.range(0, 12));
+        user["followers_count"] = random.range(0, 100000);
+        user["verified"] = random.chance(5);
+        JSON& hashtags = status["entities"]["hashtags"] = JSON::array();
+        for (int j = random.range(0, 3); j > 0; --j) {
+            JSON hashtag;
+            hashtag["text"] = word(random);
+            hashtag["indices"][0] = random.range(0, 70);
+            hashtag["indices"][1] = random.range(70, 140);
+            hashtags[hashtags.size()] = std::move(hashtag);
+        }
+        statuses[i] = std::move(status);
+    }
+    return json.dump(true);
+}
+
+// number-heavy, like canada.json
+static std::string canada(Random& random) {
+    JSON json;
+    json["type"] = "FeatureCollection";
+    JSON& features = json["features"] = JSON::array();
+    for (int i = 0; i < 40; ++i) {
+        JSON feature;
+        feature["type"] = "Feature";
+        feature["properties"]["name"] = "Canada";
+        feature["geometry"]["type"] = "Polygon";
+        JSON& ring = feature["geometry"]["coordinates"][0] = JSON::array();
+        for (int j = 0; j < 1000; ++j) {
+            ring[j][0] = random.real(-141, -52);
+            ring[j][1] = random.real(41, 84);
+        }
+        features[i] = std::move(feature);
+    }
+    return json.dump();
+}
+
+// long homogeneous number arrays, like time series
+static std::string series(Random& random) {
+    JSON json;
+    JSON& timestamps = json["timestamps"] = JSON::array();
+    JSON& values = json["values"] = JSON::array();
+    std::int64_t timestamp = 1409443755000;
+    for (int i = 0; i < 50000; ++i) {
+        timestamp += random.range(900, 1100);
+        timestamps[i] = timestamp;
+        values[i] = random.real(-1000, 1000);
+    }
+    return json.dump();
+}
+
+// string-heavy, long values with escapes
+static std::string strings(Random& random) {
+    JSON json = JSON::array();
+    for (int i = 0; i < 5000; ++i) {
+        std::string string = sentence(random, random.range(10, 60));
+        if (random.chance(30))
+            string += "\n\t\"quoted\" \\ path/to/file";
+        json[i] = std::move(string);
+    }
+    return json.dump();
+}
+
+// deeply nested, close to JSON_MAX_DEPTH
+static std::string nested(Random& random) {
+    JSON json = JSON::array();
+    for (int i = 0; i < 2000; ++i) {
+        JSON document = random.range(0, 100);
+        for (int depth = 0; depth < JSON_MAX_DEPTH - 2; ++depth) {
+            JSON parent;
+            if (depth % 2 == 0) {
+                parent["child"] = std::move(document);
+                parent["depth"] = depth;
+            } else {
+                parent[0] = std::move(document);
+                parent[1] = word(random);
+            }
+            document = std::move(parent);
+        }
+        json[i] = std::move(document);
+    }
+    return json.dump();
+}
+
+struct Result {
+    std::size_t iterations = 0;
+    double seconds = 0;
+    std::size_t allocations = 0;
+    std::size_t allocated_bytes = 0;
+};
+
+static volatile std::size_t sink;  // keeps results observable to the optimizer
+
+// repeats f for at least the given time, allocations are counted for a single run
+template <class F>
+static Result measure(double min_seconds, F&& f) {
+    using Clock = std::chrono::steady_clock;
+
+    Result result;
+    std::size_t a0 = allocations.load();
+    std::size_t b0 = allocated_bytes.load();
+    f();
+    result.allocations = allocations.load() - a0;
+    result.allocated_bytes = allocated_bytes.load() - b0;
+
+    Clock::time_point start = Clock::now();
+    do {
+        f();
+        ++result.iterations;
+        result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    } while (result.seconds < min_seconds);
+    return result;
+}
+
+static void report(const char* corpus, const char* op, std::size_t bytes, const Result& result) {
+    JSON line;
+    line["corpus"] = corpus;
+    line["op"] = op;
+    line["bytes"] = static_cast<std::int64_t>(bytes);
+    line["iterations"] = static_cast<std::int64_t>(result.iterations);
+    line["mb_per_s"] = bytes * result.iterations / result.seconds / 1e6;
+    line["docs_per_s"] = result.iterations / result.seconds;
+    line["allocs_per_doc"] = static_cast<std::int64_t>(result.allocations);
+    line["alloc_bytes_per_doc"] = static_cast<std::int64_t>(result.allocated_bytes);
+    std::printf("%s\n", line.dump().c_str());
+}
+
+// usage: json_bench [seconds] [corpus...], prints one JSON object per line
+int main(int argc, char** argv) {
+    double min_seconds = argc > 1 ? std::atof(argv[1]) : 0.5;
+
+    struct {
+        const char* name;
+        std::string (*generate)(Random&);
+    } corpora[] = {
+        {"twitter", twitter},
+        {"canada", canada},
+        {"series", series},
+        {"strings", strings},
+        {"nested", nested},
+    };
+
+    for (const auto& corpus : corpora) {
+        bool selected = argc <= 2;
+        for (int i = 2; i < argc; ++i)
+            selected = selected || std::strcmp(argv[i], corpus.name) == 0;
+        if (!selected)
+            continue;
+
+        Random random;
+        std::string src = corpus.generate(random);
+
+        JSON json;
+        if (!json.parse(src)) {
+            std::fprintf(stderr, "%s: invalid corpus\n", corpus.name);
+            return EXIT_FAILURE;
+        }
+
+        Result parse = measure(min_seconds, [&] {
+            JSON doc;
+            doc.parse(src);
+            sink = doc.size();
+        });
+        report(corpus.name, "parse", src.size(), parse);
+
+        JSON::Parser parser;
+        JSON reused;
+        for (int i = 0; i < 2; ++i)  // builds the tree, then grows the scratch to hold it
+            parser.parse(reused, src);
+        Result reuse = measure(min_seconds, [&] {
+            parser.parse(reused, src);
+            sink = reused.size();
+        });
+        report(corpus.name, "parse_reuse", src.size(), reuse);
+
+        std::size_t size = json.dump().size();
+        Result dump = measure(min_seconds, [&] { sink = json.dump().size(); });
+        report(corpus.name, "dump", size, dump);
+
+        size = json.dump(true).size();
+        Result pretty = measure(min_seconds, [&] { sink = json.dump(true).size(); });
+        report(corpus.name, "dump_pretty", size, pretty);
+
+        Result minify = measure(min_seconds, [&] { sink = JSON::minify(src).size(); });
+        report(corpus.name, "minify", src.size(), minify);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,7 @@
+#define JSON_COW
+#define JSON_HASH_CACHE
+#define JSON_STATS
+#define JSON_VALIDATE_UTF8
+#define JSON_RAW_NUMBERS
+#define JSON_PACKED_ARRAYS
+#include "json_test.cpp"
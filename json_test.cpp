@@ -1,10 +1,39 @@
+#include <algorithm>
 #include <cassert>
 #include <cstdio>
+#include <cstring>
+#include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
+#include <vector>
 
 #define JSON_IMPLEMENTATION
 #include "json.hpp"
 
+namespace test {
+
+struct Point {
+    double x;
+    double y;
+};
+
+struct Shape {
+    std::string name;
+    int sides = 0;
+    bool closed = false;
+    std::vector<Point> points;
+    std::optional<std::string> label;
+    JSON extra;
+};
+
+JSON_FIELDS(Point, x, y)
+JSON_FIELDS(Shape, name, sides, closed, points, label, extra)
+
+}  // namespace test
+
 int main() {
     JSON::Status status;
 
@@ -238,6 +267,915 @@ int main() {
         std::printf("success\n");
     }
 
+    {
+        std::printf("lookup: ");
+        JSON json;
+        assert(json.parse(R"({"key": "value", "array": [1, 2]})", &status) == true);
+        const JSON& cjson = json;
+        std::string_view key = "key";
+        assert(cjson.find(key) != nullptr);
+        assert(cjson.find(key)->get_string() == "value");
+        assert(cjson.find("missing_key") == nullptr);
+        assert(cjson["missing_key"].is_null());
+        assert(cjson["array"][1].get_int64() == 2);
+        assert(cjson["array"][2].is_null());
+        assert(cjson.size() == 2);
+        assert(json.find("array")->size() == 2);
+        assert(cjson["array"].get_array().size() == 2);
+        assert(cjson["array"].get_object().empty());
+        json[key] = "new value";
+        assert(cjson["key"].get_string() == "new value");
+        assert(cjson.size() == 2);
+        std::printf("success\n");
+    }
+
+    {
+        std::printf("projection: ");
+        JSON json;
+        JSON projection;
+        projection["id"] = true;
+        projection["user"]["name"] = true;
+        projection["items"]["price"] = true;
+        projection["ignored"] = false;
+        std::string string = R"(
+            {
+              "id": 69,
+              "text": "skipped \"string\"",
+              "user": {"name": "name", "bio": {"nested": [1, 2, {"deep": null}]}},
+              "items": [{"price": 1.42, "tags": ["a", "b"]}, {"price": 2}],
+              "ignored": [1, 2, 3],
+            }
+        )";
+        assert(json.parse(string, projection, &status) == true);
+        assert(status == JSON::SUCCESS);
+        assert(json.size() == 3);
+        assert(json["id"].get_int64() == 69);
+        assert(json["user"].size() == 1);
+        assert(json["user"]["name"].get_string() == "name");
+        assert(json["items"].size() == 2);
+        assert(json["items"][0].size() == 1);
+        assert(json["items"][1]["price"].get_int64() == 2);
+        assert(json.dump() == R"({"id":69,"items":[{"price":1.42},{"price":2}],"user":{"name":"name"}})");
+        assert(json.parse(R"({"text": "\x"})", projection, &status) == false);
+        assert(status == JSON::INVALID_STRING_ESCAPE);
+        assert(json.parse(string, true) && json.size() == 5);  // whole value
+        assert(json.parse(string, false) && json.is_null());   // validated only
+        assert(!json.parse(R"(["\x"])", false, &status) && status == JSON::INVALID_STRING_ESCAPE);
+        std::printf("success\n");
+    }
+
+    {
+        std::printf("patch: ");
+        JSON json, patch;
+        assert(json.parse(R"({"a": {"b": [1, 2, 3]}, "c": "value", "d~/": true})"));
+        assert(patch.parse(R"([
+            {"op": "test", "path": "/a/b/0", "value": 1.0},
+            {"op": "add", "path": "/a/b/1", "value": 69},
+            {"op": "add", "path": "/a/b/-", "value": 4},
+            {"op": "remove", "path": "/a/b/0"},
+            {"op": "replace", "path": "/c", "value": {"x": null}},
+            {"op": "move", "from": "/d~0~1", "path": "/c/y"},
+            {"op": "copy", "from": "/c", "path": "/e"},
+        ])"));
+        assert(json.patch(patch, &status) == true);
+        assert(status == JSON::SUCCESS);
+        assert(json.dump() ==
+               R"({"a":{"b":[69,2,3,4]},"c":{"x":null,"y":true},"e":{"x":null,"y":true}})");
+
+        assert(patch.parse(R"([
+            {"op": "remove", "path": "/e"},
+            {"op": "test", "path": "/a/b/0", "value": 1}
+        ])"));
+        assert(json.patch(patch, &status) == false);
+        assert(status == JSON::TEST_FAILED);
+        assert(json.dump() ==
+               R"({"a":{"b":[69,2,3,4]},"c":{"x":null,"y":true},"e":{"x":null,"y":true}})");
+        assert(patch.parse(R"([{"op": "remove", "path": "/a/b/4"}])"));
+        assert(json.patch(patch, &status) == false);
+        assert(status == JSON::PATH_NOT_FOUND);
+        assert(patch.parse(R"([{"op": "move", "from": "/a", "path": "/a/b"}])"));
+        assert(json.patch(patch, &status) == false);
+        assert(status == JSON::INVALID_PATCH);
+        assert(patch.parse(R"([{"op": "add", "path": "a"}])"));
+        assert(json.patch(patch, &status) == false);
+        assert(status == JSON::INVALID_PATCH);
+
+        std::string before = json.dump();
+        const JSON* untouched = json["a"]["b"].get_array().data();  // patched in place
+        assert(patch.parse(R"([
+            {"op": "add", "path": "/a/b/0", "value": 0},
+            {"op": "remove", "path": "/c/x"},
+            {"op": "move", "from": "/e", "path": "/a/e"},
+            {"op": "move", "from": "/a/b/1", "path": "/a/b/-"},
+            {"op": "replace", "path": "/c", "value": []},
+            {"op": "copy", "from": "/a", "path": "/c/0"},
+            {"op": "add", "path": "", "value": {"new": 1}},
+            {"op": "test", "path": "/new", "value": 2}
+        ])"));
+        assert(json.patch(patch, &status) == false && status == JSON::TEST_FAILED);
+        assert(json.dump() == before);
+        assert(patch.parse(R"([{"op": "move", "from": "/a/b/0", "path": "/x/y"}])"));
+        assert(json.patch(patch, &status) == false && status == JSON::INVALID_POINTER);
+        assert(json.dump() == before);  // the moved value is put back
+        assert(patch.parse(R"([{"op": "replace", "path": "/c/x", "value": 1}])"));
+        assert(json.patch(patch) && json["a"]["b"].get_array().data() == untouched);
+        std::printf("success\n");
+    }
+
+    {
+        std::printf("merge patch: ");
+        JSON json, patch;
+        assert(json.parse(R"({"a": "b", "c": {"d": "e", "f": "g"}})"));
+        assert(patch.parse(R"({"a": "z", "c": {"f": null}, "h": [1]})"));
+        json.merge_patch(patch);
+        assert(json.dump() == R"({"a":"z","c":{"d":"e"},"h":[1]})");
+        json.merge_patch(JSON::array());
+        assert(json.dump() == "[]");
+        std::printf("success\n");
+    }
+
+    {
+        std::printf("diff: ");
+        JSON source, target;
+        assert(source.parse(R"({"a": [1, 2, 3], "b": {"c": 1}, "d/": "x", "e": 1})"));
+        assert(target.parse(R"({"a": [1, 5], "b": {"c": 1.0, "x": []}, "d/": "y", "f": 1})"));
+        JSON ops = JSON::diff(source, target);
+        assert(ops.dump() ==
+               R"([{"op":"replace","path":"\/a\/1","value":5},)"
+               R"({"op":"remove","path":"\/a\/2"},)"
+               R"({"op":"add","path":"\/b\/x","value":[]},)"
+               R"({"op":"replace","path":"\/d~1","value":"y"},)"
+               R"({"op":"remove","path":"\/e"},)"
+               R"({"op":"add","path":"\/f","value":1}])");
+        assert(source.patch(ops) == true);
+        assert(source.dump() == R"({"a":[1,5],"b":{"c":1,"x":[]},"d\/":"y","f":1})");
+        assert(JSON::diff(source, source).empty());
+
+        assert(source.parse("[1, 2, 3, 4, 5, 6]"));
+        assert(target.parse("[0, 1, 2, 3, 4, 5, 6]"));
+        assert(JSON::diff(source, target).dump() == R"([{"op":"add","path":"\/0","value":0}])");
+        assert(target.parse("[1, 2, 4, 5, 6]"));
+        assert(JSON::diff(source, target).dump() == R"([{"op":"remove","path":"\/2"}])");
+        assert(target.parse("[1, 7, 8, 9, 6]"));
+        ops = JSON::diff(source, target);
+        assert(source.patch(ops) == true);
+        assert(source == target);
+        std::printf("success\n");
+    }
+
+    {
+        std::printf("copy: ");
+        JSON json1;
+        assert(json1.parse(R"({"array": [1, {"key": "value"}], "object": {"key": "value"}})"));
+        JSON json2 = json1;
+        JSON json3;
+        json3 = json2;
+        json2["array"][1]["key"] = "new value";
+        json3["object"].get_object().erase("key");
+        json3["array"].get_array().emplace_back(2);
+        assert(json1.dump() == R"({"array":[1,{"key":"value"}],"object":{"key":"value"}})");
+        assert(json2.dump() == R"({"array":[1,{"key":"new value"}],"object":{"key":"value"}})");
+        assert(json3.dump() == R"({"array":[1,{"key":"value"},2],"object":{}})");
+        assert(JSON::diff(json1, json2).size() == 1);
+        assert(JSON::diff(json1, json3).size() == 2);
+        std::printf("success\n");
+    }
+
+    {
+        std::printf("equality: ");
+        JSON json1, json2, json3;
+        assert(json1.parse(R"({"a": [1, 2.5, "x", null], "b": {"c": true}})"));
+        assert(json2.parse(R"({"b": {"c": true}, "a": [1.0, 2.5, "x", null]})"));
+        assert(json3.parse(R"({"a": [1, 2.5, "x", null], "b": {"c": false}})"));
+        assert(json1 == json2);
+        assert(json1 != json3);
+        assert(json1.hash() == json2.hash());
+        assert(std::hash<JSON>{}(json1) == json2.hash());
+        assert(json1 > json3);
+        assert(JSON{1} < JSON{1.5});
+        assert(JSON{nullptr} < JSON{false});
+        assert(JSON{"a"} < JSON{"b"});
+        assert(JSON::array() < JSON::object());
+        assert((JSON{2} <=> JSON{2.0}) == 0);
+        JSON big{std::int64_t{9007199254740993}};  // 2^53 + 1 isn't a double
+        assert(big != JSON{9007199254740992.0} && big > JSON{9007199254740992.0});
+        assert(JSON{std::int64_t{1} << 53} == JSON{9007199254740992.0});
+        assert(JSON{std::int64_t{1} << 53}.hash() == JSON{9007199254740992.0}.hash());
+        assert(JSON{INT64_MAX} < JSON{0x1p63} && JSON{-3} < JSON{-2.5});
+
+        std::unordered_set<JSON> set{json1, json2, json3};
+        assert(set.size() == 2);
+        json2["a"][0] = 2;
+        assert(json1 != json2);
+        assert(json1.hash() != json2.hash());
+
+        JSON& child = json1["a"];  // written through after the parents were hashed
+        json1.hash();
+        json2.hash();
+        child[0] = 2;
+        assert(json1 == json2 && json1.hash() == json2.hash());
+        std::printf("success\n");
+    }
+
+    {
+        std::printf("binding: ");
+        test::Shape shape;
+        std::string string = R"(
+            {
+              "name": "triangle",
+              "ignored": {"key": [1, 2, "value"]},
+              "sides": 3,
+              "closed": true,
+              "points": [{"x": 0, "y": 0}, {"x": 1.5, "y": 0, "z": 1}, {"y": 1, "x": 0.5}],
+              "label": null,
+              "extra": {"key": "value"},
+            }
+        )";
+        assert(JSON::read(string, shape, &status) == true);
+        assert(status == JSON::SUCCESS);
+        assert(shape.name == "triangle");
+        assert(shape.sides == 3);
+        assert(shape.closed == true);
+        assert(shape.points.size() == 3);
+        assert(shape.points[1].x == 1.5);
+        assert(shape.points[2].y == 1);
+        assert(shape.label.has_value() == false);
+        assert(shape.extra["key"].get_string() == "value");
+
+        shape.label = "label";
+        std::string dump = JSON::write(shape);
+        JSON json;
+        assert(json.parse(dump, &status) == true);
+        assert(json["points"][1]["x"].get_double() == 1.5);
+        assert(json["label"].get_string() == "label");
+        assert(json["extra"]["key"].get_string() == "value");
+        assert(JSON::write(shape.points, true) == json["points"].dump(true));
+        assert(JSON::write(std::vector<int>{1, 2}) == "[1,2]");
+
+        assert(JSON::read(R"({"sides": "3"})", shape, &status) == false);
+        assert(status == JSON::TYPE_MISMATCH);
+        assert(JSON::read(R"({"points": {}})", shape, &status) == false);
+        assert(status == JSON::TYPE_MISMATCH);
+
+        std::uint8_t small = 0;
+        unsigned u = 0;
+        std::int64_t int64 = 0;
+        assert(JSON::read("255", small) == true && small == 255);
+        assert(JSON::read("300", small, &status) == false && status == JSON::TYPE_MISMATCH);
+        assert(JSON::read("-1", u, &status) == false && status == JSON::TYPE_MISMATCH);
+        assert(JSON::read("-9223372036854775807", int64) == true && int64 == -INT64_MAX);
+#ifdef JSON_RAW_NUMBERS
+        std::uint64_t id = 0;
+        assert(JSON::read("18446744073709551615", id) == true && id == 18446744073709551615u);
+        assert(JSON::write(id) == "18446744073709551615");
+        assert(JSON::read("18446744073709551616", id, &status) == false);
+        assert(JSON::read("9223372036854775808", int64, &status) == false);
+        assert(status == JSON::TYPE_MISMATCH);
+#endif  // JSON_RAW_NUMBERS
+        std::printf("success\n");
+    }
+
+    {
+        std::printf("literal: ");
+        static constexpr auto literal = JSON::literal<R"(
+            {
+              // comments are ignored
+              "string": "hello \"world\"",
+              "array": [null, true, -69, 1.42, 1e3, -0.25e-2],
+              "object": {"key": "value", "empty": {}},
+              "empty_array": [], // trailing comma is allowed
+            }
+        )">();
+        static_assert(literal.root().is_object());
+        static_assert(literal.root().size() == 4);
+        static_assert(literal["string"].get_string() == "hello \"world\"");
+        static_assert(literal["array"].size() == 6);
+        static_assert(literal["array"][0].is_null());
+        static_assert(literal["array"][1].get_bool() == true);
+        static_assert(literal["array"][2].get_int64() == -69);
+        static_assert(literal["array"][3].get_double() == 1.42);
+        static_assert(literal["array"][4].get_double() == 1000);
+        static_assert(literal["array"][5].get_double() == -0.0025);
+        static_assert(literal["array"][6].is_null());
+        static_assert(literal["object"]["key"].get_string() == "value");
+        static_assert(literal["object"].has("empty"));
+        static_assert(literal["object"].has("missing_key") == false);
+        static_assert(literal["empty_array"].empty());
+        static_assert(literal["missing_key"].get_int64(-1) == -1);
+        static_assert(literal["missing_key"].get_string("value") == "value");
+        static_assert(sizeof(JSON::literal<"[1, 2]">()) ==  // sized by values, not characters
+                      sizeof(JSON::literal<"[1,     // one\n     2]">()));
+        static constexpr auto numbers =  // rounded like strtod, inexact ones fail the build
+            JSON::literal<"[1e22, 1e23, 1.5000000000000000000000, 0.1, -0e400, 4.5e-21]">();
+        static_assert(numbers[0].get_double() == 1e22 && numbers[1].get_double() == 1e23);
+        static_assert(numbers[2].get_double() == 1.5 && numbers[3].get_double() == 0.1);
+        static_assert(numbers[4].get_double() == 0 && numbers[5].get_double() == 4.5e-21);
+
+        JSON json;
+        assert(json.parse(R"({
+            "string": "hello \"world\"",
+            "array": [null, true, -69, 1.42, 1e3, -0.25e-2],
+            "object": {"key": "value", "empty": {}},
+            "empty_array": [],
+        })"));
+        assert(literal.root().to_json() == json);
+        assert(json.parse("[1e22, 1e23, 1.5000000000000000000000, 0.1, -0e400, 4.5e-21]"));
+        assert(numbers.root().to_json() == json);
+        std::printf("success\n");
+    }
+
+    {
+        std::printf("schema: ");
+        JSON definition;
+        assert(definition.parse(R"({
+            "type": "object",
+            "required": ["id", "tags"],
+            "properties": {
+                "id": {"type": "integer", "minimum": 1},
+                "name": {"type": "string", "minLength": 1, "maxLength": 4},
+                "tags": {"type": "array", "maxItems": 2, "items": {"enum": ["a", "b/c"]}},
+                "score": {"type": ["number", "null"], "maximum": 1}
+            }
+        })"));
+        JSON::Schema schema;
+        assert(schema.compile(definition));
+
+        JSON json;
+        JSON::Status status;
+        std::string path;
+        assert(json.parse(R"({"id": 1, "name": "жук", "tags": ["a"], "score": 0.5})", schema));
+        assert(json["name"].get_string() == "жук");
+        assert(json.parse(R"({"id": 1, "tags": [], "score": null, "other": 1})", schema));
+
+        assert(!json.parse(R"({"id": 0, "tags": []})", schema, &status, &path));
+        assert(status == JSON::SCHEMA_RANGE && path == "/id");
+        assert(!json.parse(R"({"id": 1.5, "tags": []})", schema, &status, &path));
+        assert(status == JSON::SCHEMA_TYPE && path == "/id");
+        assert(!json.parse(R"({"id": 1, "name": "", "tags": []})", schema, &status, &path));
+        assert(status == JSON::SCHEMA_RANGE && path == "/name");
+        assert(!json.parse(R"({"id": 1, "tags": ["a", "c"]})", schema, &status, &path));
+        assert(status == JSON::SCHEMA_ENUM && path == "/tags/1");
+        assert(!json.parse(R"({"id": 1, "tags": ["a", "a", "a"]})", schema, &status, &path));
+        assert(status == JSON::SCHEMA_RANGE && path == "/tags");
+        assert(!json.parse(R"({"id": 1, "tags": {"b/c": 1}})", schema, &status, &path));
+        assert(status == JSON::SCHEMA_TYPE && path == "/tags");
+        assert(!json.parse(R"({"id": 1})", schema, &status, &path));
+        assert(status == JSON::SCHEMA_REQUIRED && path.empty());
+        assert(!json.parse(R"([])", schema, &status, &path));
+        assert(status == JSON::SCHEMA_TYPE && path.empty());
+        assert(!json.parse(R"({"id": 1, "tags": ["\x"]})", schema, &status, &path));
+        assert(status == JSON::INVALID_STRING_ESCAPE && path.empty());
+
+        assert(!schema.compile(JSON::array(), &status));
+        assert(status == JSON::INVALID_SCHEMA);
+        assert(!schema.compile(JSON::object({{"type", "float"}})));
+        assert(!schema.compile(JSON::object({{"minLength", -1}})));
+        std::printf("success\n");
+    }
+
+#ifdef JSON_STATS
+    {
+        std::printf("stats: ");
+        std::vector<JSON::Stats> reports;
+        JSON::set_stats_callback([&](const JSON::Stats& stats) { reports.push_back(stats); });
+
+        JSON json;
+        std::string src =
+            R"({"name": "a string longer than small buffer", "items": [1, 2.5, null]})";
+        assert(json.parse(src));
+        assert(reports.size() == 1);
+        JSON::Stats parse = reports[0];
+        assert(parse.phase == JSON::Stats::PARSE && parse.status == JSON::SUCCESS);
+        assert(parse.nodes[JSON::TYPE_OBJECT] == 1);
+        assert(parse.nodes[JSON::TYPE_ARRAY] == 1);
+        assert(parse.nodes[JSON::TYPE_STRING] == 1);
+        assert(parse.nodes[JSON::TYPE_INT64] == 1);
+        assert(parse.nodes[JSON::TYPE_DOUBLE] == 1);
+        assert(parse.nodes[JSON::TYPE_NULL] == 1);
+        assert(parse.string_bytes == 4 + 33 + 5);
+        assert(parse.max_depth == 2);
+        assert(parse.allocations > 0 && parse.allocated_bytes > 0);
+        assert(parse.bytes == src.size());
+
+        std::string dump = json.dump();
+        assert(reports.size() == 2);
+        JSON::Stats stats = reports[1];
+        assert(stats.phase == JSON::Stats::DUMP);
+        assert(stats.nodes[JSON::TYPE_STRING] == 1 && stats.max_depth == 2);
+        assert(stats.string_bytes == parse.string_bytes);
+        assert(stats.bytes == dump.size() && stats.allocations > 0);
+
+        assert(!json.parse(R"([1, "\x"])"));
+        assert(reports.size() == 3 && reports[2].status != JSON::SUCCESS);
+
+        JSON::set_stats_callback(nullptr);
+        json.dump();
+        assert(reports.size() == 3);
+        std::printf("success\n");
+    }
+#endif  // JSON_STATS
+
+    {
+        std::printf("unicode: ");
+        JSON json;
+        assert(json.parse("\"é中\U0001F600 and a long tail to scan\""));
+        assert(json.get_string() == "é中\U0001F600 and a long tail to scan");
+        assert(json.parse(R"("é中😀 and a long tail to scan")"));
+        assert(json.get_string() == "é中\U0001F600 and a long tail to scan");
+        assert(json.parse(R"(["\u0000", "\u0041", "\"quoted\" \\ escaped \/"])"));
+        assert(json[0].get_string() == std::string(1, '\0'));
+        assert(json[1].get_string() == "A");
+        assert(json[2].get_string() == "\"quoted\" \\ escaped /");
+        assert(!json.parse(R"("\u12")"));
+        assert(!json.parse(R"("\ud800\u12x4")"));
+
+#ifdef JSON_VALIDATE_UTF8
+        assert(!json.parse(R"("\ud800")", &status) && status == JSON::INVALID_UTF8);
+        assert(!json.parse(R"("\udc00\ud800")", &status) && status == JSON::INVALID_UTF8);
+        assert(!json.parse("\"valid ascii prefix \xff\"", &status) && status == JSON::INVALID_UTF8);
+        assert(!json.parse("\"\xc0\xaf\"", &status) && status == JSON::INVALID_UTF8);
+        assert(!json.parse("\"\xed\xa0\x80\"", &status) && status == JSON::INVALID_UTF8);
+        assert(!json.parse("\"\xf4\x90\x80\x80\"", &status) && status == JSON::INVALID_UTF8);
+        assert(!json.parse("\"\xe4\xb8\"", &status) && status == JSON::INVALID_UTF8);
+        assert(json.parse("\"\xf4\x8f\xbf\xbf \xe4\xb8\xad\""));
+#else   // JSON_VALIDATE_UTF8
+        assert(json.parse(R"("\ud800")", &status) && json.get_string() == "\xef\xbf\xbd");
+        assert(json.parse("\"\xff\"") && json.get_string() == "\xff");
+#endif  // JSON_VALIDATE_UTF8
+
+        json = "é中\U0001F600 \x01\x1f/";
+        assert(json.dump() == "\"é中\U0001F600 \\u0001\\u001f\\/\"");
+        assert(json.dump(false, true) == R"("\u00e9\u4e2d\ud83d\ude00 \u0001\u001f\/")");
+        JSON copy;
+        assert(copy.parse(json.dump(false, true)) && copy == json);
+        json = "\xff";
+        assert(json.dump(false, true) == R"("\ufffd")");
+
+        static constexpr auto literal = JSON::literal<R"(["\u00e9", "\ud83d\ude00"])">();
+        static_assert(literal[0].get_string() == "é");
+        static_assert(literal[1].get_string() == "\U0001F600");
+        std::printf("success\n");
+    }
+
+    {
+        std::printf("numbers: ");
+        JSON json;
+        std::string string =
+            R"([18446744073709551615,-9223372036854775807,0.10000000000000001,1e2])";
+        assert(json.parse(string));
+        assert(json[0].is_int64());
+        assert(json[1].get_int64() == -INT64_MAX && json[1].get_uint64(69) == 69);
+        assert(json[2].is_double() && json[2].get_double() == 0.1);
+        assert(json[3].is_double() && json[3].get_int64() == 100);
+        assert(JSON{std::uint64_t{1} << 63}.get_uint64() == std::uint64_t{1} << 63);
+        assert(JSON{-1}.get_uint64(69) == 69);
+        assert(JSON{1e19}.get_uint64() == 10000000000000000000u);
+#ifdef JSON_RAW_NUMBERS
+        assert(json[0].get_uint64() == 18446744073709551615u);
+        assert(json.dump() == string);  // numbers are emitted as they were parsed
+        JSON copy = json;
+        assert(copy == json && copy.hash() == json.hash());
+        assert(copy[2] == 0.1 && copy[2] < 0.2);
+        copy[2] = 0.5;
+        assert(copy.dump() == R"([18446744073709551615,-9223372036854775807,0.5,1e2])");
+        assert(json.parse("[1., - 2, 07]"));
+        assert(json.dump() == "[1,-2,0,7]");
+
+        JSON id1, id2;  // ids that don't fit into int64 stay distinct
+        assert(id1.parse(R"({"id": 18446744073709551615})"));
+        assert(id2.parse(R"({"id": 18446744073709551614})"));
+        assert(id1 != id2 && id1.hash() != id2.hash() && id2 < id1 && id1["id"] > JSON{INT64_MAX});
+        assert(JSON::diff(id1, id2).dump() ==
+               R"([{"op":"replace","path":"\/id","value":18446744073709551614}])");
+        assert(id2.parse(R"({"id": 18446744073709551615})") && id1 == id2);
+        assert(id1.hash() == id2.hash());
+        assert(json.parse("[-99999999999999999999, -99999999999999999998]"));
+        assert(json[0] < json[1] && json[0] < JSON{INT64_MIN} && json[1] > JSON{-1e20});
+        assert(json[0] < JSON{-1.5} && id1["id"] > JSON{1.5} && id1["id"] < JSON{0x1p64});
+        assert(id1.parse(R"({"id": 18446744073709551616})") && id1["id"] == JSON{0x1p64});
+        assert(id1["id"].hash() == JSON{0x1p64}.hash());
+#endif  // JSON_RAW_NUMBERS
+        std::printf("success\n");
+    }
+
+    {
+        std::printf("packed: ");
+        JSON json;
+        std::string string =
+            "[[1,2,3,4,5,6,7,8],[0.5,1.5,2.5,3.5,4.5,5.5,6.5,7.5],[1,2,3,4,5,6,7,0.5]]";
+        assert(json.parse(string));
+        const JSON& data = json;
+        assert(data.dump() == string && data[0].size() == 8 && data[1][2] == 2.5);
+#ifdef JSON_PACKED_ARRAYS
+        assert(data[0].get_int64s().size() == 8 && data[0].get_int64s()[7] == 8);
+        assert(data[1].get_doubles()[1] == 1.5 && data[1].get_int64s().empty());
+        assert(data[2].get_doubles().empty());  // mixed types stay as nodes
+        JSON nodes = json;
+        nodes[0][0] = 1;  // modified arrays are unpacked
+        nodes[1][0] = 0.5;
+        assert(nodes[0].get_int64s().empty() && nodes == json && nodes.hash() == json.hash());
+        assert(nodes.dump(true) == json.dump(true));
+        nodes[0][1] = "two";
+        assert(nodes[0][1] == "two" && nodes[0][2] == 3 && nodes != json);
+        JSON ints, doubles, checked;  // read without expanding into nodes
+        assert(ints.parse("[1,2,3,4,5,6,7,8]") && doubles.parse("[1,2,3,4,5,6,7.5,8]"));
+        std::size_t bytes = ints.memory_usage().total() + doubles.memory_usage().total();
+        assert(ints != doubles && ints < doubles && JSON::diff(ints, doubles).size() == 1);
+        JSON::Schema items;
+        assert(items.compile(JSON::object({{"type", "array"}, {"maxItems", 8}})));
+        assert(checked.parse("[1,2,3,4,5,6,7,8]", items));
+        assert(ints.memory_usage().total() + doubles.memory_usage().total() == bytes);
+        assert(checked.memory_usage().total() == ints.memory_usage().total());
+#ifdef JSON_COW
+        JSON copy = json;  // the numbers are shared until either array is modified
+        const JSON& shared = copy;
+        assert(shared[1].get_doubles().data() == data[1].get_doubles().data());
+        copy[1][0] = 9.5;
+        assert(data[1][0] == 0.5 && shared[1][0] == 9.5 && shared[1].get_doubles().empty());
+        JSON twice;
+        assert(twice.parse("[[1,2,3,4,5,6,7,8],[1,2,3,4,5,6,7,8]]"));
+        twice.dedupe();
+        const JSON& deduped = twice;
+        assert(deduped[0].get_int64s().data() == deduped[1].get_int64s().data());
+#endif  // JSON_COW
+#endif  // JSON_PACKED_ARRAYS
+        std::printf("success\n");
+    }
+
+    {
+        std::printf("columns: ");
+        std::string string = R"([
+            {"id": 1, "name": "a", "score": 1, "tags": []},
+            {"id": 2, "score": 2.5, "extra": true},
+            7,
+            {"id": 3, "name": null, "score": 3, "tags": "x", "id": 4}
+        ])";
+        JSON json;
+        assert(json.parse(string));
+        JSON::Table parsed;
+        assert(parsed.parse(string));
+        for (const JSON::Table& table : {json.to_columns(), std::move(parsed)}) {
+            assert(table.rows() == 4 && table.columns().size() == 5);
+            const JSON::Table::Column* id = table.column("id");
+            assert(id->type == JSON::TYPE_INT64);
+            assert(id->int64s == std::vector<std::int64_t>({1, 2, 0, 3}));
+            assert(id->nulls == std::vector<bool>({false, false, true, false}));
+            const JSON::Table::Column* score = table.column("score");
+            assert(score->type == JSON::TYPE_DOUBLE && score->doubles[1] == 2.5);
+            assert(score->int64s.empty() && score->doubles[3] == 3);
+            const JSON::Table::Column* name = table.column("name");
+            assert(name->strings == std::vector<std::string>({"a", "", "", ""}));
+            assert(name->nulls == std::vector<bool>({false, true, true, true}));
+            const JSON::Table::Column* tags = table.column("tags");
+            assert(tags->mixed && tags->values[0] == JSON::array() && tags->values[3] == "x");
+            const JSON::Table::Column* extra = table.column("extra");
+            assert(extra->type == JSON::TYPE_BOOL && extra->bools[1] && extra->nulls[0]);
+            assert(table.column("missing") == nullptr);
+        }
+        assert(!parsed.parse("{}", &status) && status == JSON::TYPE_MISMATCH);
+        std::printf("success\n");
+    }
+
+    {
+        std::printf("parser: ");
+        JSON::Parser parser;
+        JSON json;
+        std::string text(64, 'x');
+        assert(parser.parse(json, R"({"text": ")" + text + R"(", "values": [1, 2, 3]})"));
+        const char* chars = json["text"].get_string().data();
+        const JSON* values = json["values"].get_array().data();
+        assert(parser.parse(json, R"({"text": ")" + text + R"(", "values": [4, 5]})"));
+        assert(json["text"].get_string().data() == chars);  // storage is reused
+        assert(json["values"].get_array().data() == values);
+        assert(json["values"] == JSON::array({4, 5}));
+        JSON copy = json;
+        std::string string = R"([{"a": 1, "a": 2}, ")" + text + R"(", [[]], null])";
+        JSON expected;
+        assert(expected.parse(string) && parser.parse(json, string) && json == expected);
+        assert(copy["values"].size() == 2 && copy["text"] == text);
+#ifdef JSON_STRICT
+        assert(!parser.parse(json, "[1, 2", &status) && status == JSON::UNEXPECTED_END);
+#else   // JSON_STRICT
+        assert(parser.parse(json, "[1, 2", &status) && status == JSON::SUCCESS);
+        assert(json == JSON::array({1, 2}));  // closed at the end of the input
+#endif  // JSON_STRICT
+        parser.clear();
+        assert(parser.parse(json, "{}") && json.is_object() && json.empty());
+        std::printf("success\n");
+    }
+
+    {
+        std::printf("freeze: ");
+        JSON json;
+        assert(json.parse(R"({"name": "config", "values": [1, 2.5, "three"]})"));
+        std::shared_ptr<const JSON> frozen = json.freeze();
+        json["name"] = "changed";
+        assert((*frozen)["name"] == "config" && (*frozen)["values"][1] == 2.5);
+        JSON::Atomic current{std::move(frozen)};
+        std::vector<std::thread> readers;
+        for (int i = 0; i < 4; ++i) {
+            readers.emplace_back([&] {
+                for (int j = 0; j < 1000; ++j) {
+                    std::shared_ptr<const JSON> config = current.load();
+                    assert((*config)["values"].size() == 3);
+                }
+            });
+        }
+        for (int i = 0; i < 100; ++i) {
+            json["values"][0] = i;
+            current.store(json.freeze());
+        }
+        for (std::thread& reader : readers)
+            reader.join();
+        assert((*current.load())["values"][0] == 99);
+        assert(current.exchange(nullptr)->hash() == json.hash());
+        assert(JSON::Atomic{}.load()->is_null());
+        std::printf("success\n");
+    }
+
+    {
+        std::printf("path: ");
+        std::string string = R"({"store": {
+            "bicycle": {"color": "red", "price": 19.95},
+            "book": [
+                {"title": "a", "price": 8.95, "tags": ["x"]},
+                {"title": "b", "price": 12, "isbn": "1"},
+                {"title": "c", "price": 22.99, "isbn": "2"}
+            ]
+        }})";
+        JSON json;
+        assert(json.parse(string));
+        auto query = [&](std::string_view path) {
+            JSON::Path compiled;
+            assert(compiled.compile(path));
+            JSON results = JSON::array(), texts = JSON::array();
+            for (const JSON* result : compiled.select(json))
+                results[results.size()] = *result;
+            for (std::string_view view : compiled.select_text(string)) {
+                JSON text;
+                assert(text.parse(std::string{view}));
+                texts[texts.size()] = std::move(text);
+            }
+            assert(results == texts);
+            return results;
+        };
+        assert(query("$.store.book[0].title") == JSON::array({"a"}));
+        assert(query("$['store'].bicycle[\"color\"]") == JSON::array({"red"}));
+        assert(query("$.store.book[*].title") == JSON::array({"a", "b", "c"}));
+        assert(query("$.store.book[-1].title") == JSON::array({"c"}));
+        assert(query("$.store.book[0:3:2].title") == JSON::array({"a", "c"}));
+        assert(query("$.store.book[-2:].title") == JSON::array({"b", "c"}));
+        assert(query("$..price") == JSON::array({19.95, 8.95, 12, 22.99}));
+        assert(query("$.store.book[?(@.isbn)].title") == JSON::array({"b", "c"}));
+        assert(query("$..book[?(@.price < 20)].title") == JSON::array({"a", "b"}));
+        assert(query("$..[?(@.title == 'c')].price") == JSON::array({22.99}));
+        assert(query("$..book[?@.price != 12].title") == JSON::array({"a", "c"}));
+        assert(query("$.store.book[0].tags.*") == JSON::array({"x"}));
+        assert(query("$.missing[0]").empty() && query("$").size() == 1);
+        JSON::Path path;
+        assert(!path.compile("store", &status) && status == JSON::INVALID_PATH);
+        assert(!path.compile("$[1:2:0]") && !path.compile("$[?(@.a < )]"));
+        assert(path.compile("$..price") && path.select_text("[1, {]", &status).empty());
+        assert(status != JSON::SUCCESS);
+        std::printf("success\n");
+    }
+
+    {
+        std::printf("parse many: ");
+        std::string string = "{\"id\": 1} [2, 3]\n\"four\"\n{\"id\": }\n5 {\"id\": [6]}  ";
+        std::vector<std::size_t> offsets = {0, 10, 17, 24, 33, 35};
+        for (unsigned threads : {1, 3, 1000}) {
+            std::vector<JSON::Documents::Document> documents;
+            for (JSON::Documents::Document& document : JSON::parse_many(string, threads))
+                documents.push_back(std::move(document));
+            assert(documents.size() == 6);
+            for (std::size_t i = 0; i < documents.size(); ++i)
+                assert(documents[i].offset == offsets[i]);
+            assert(documents[0].json["id"] == 1 && documents[1].json == JSON::array({2, 3}));
+            assert(documents[2].json == "four" && documents[4].json == 5);
+            assert(documents[3].status != JSON::SUCCESS && documents[5].status == JSON::SUCCESS);
+            assert(documents[5].json["id"][0] == 6);
+        }
+        JSON::Documents documents{"[1] [2, 3] [4, 5, 6]"};
+        std::size_t size = 1;
+        for (const JSON::Documents::Document& document : documents)
+            assert(document.status == JSON::SUCCESS && document.json.size() == size++);
+        assert(size == 4 && JSON::parse_many(" \n ").begin() == JSON::Documents::iterator{});
+        std::printf("success\n");
+    }
+
+    {
+        std::printf("parse stream: ");
+        auto reader = [](const std::string& src) {
+            return [&src, pos = std::size_t{0}](char* buffer, std::size_t size) mutable {
+                std::size_t read = std::min(size, src.size() - pos);
+                std::memcpy(buffer, src.data() + pos, read);
+                pos += read;
+                return read;
+            };
+        };
+        std::string string = R"( [1, -2.5e3, "a,]\"", {"b": [true, "]"], "c": {}}, [],
+            // comment with ] and [
+            null, [[{"d": false}]] ] )";
+        JSON expected;
+        assert(expected.parse(string));
+        for (std::size_t chunk : {1, 2, 7, 1 << 16}) {
+            JSON json = JSON::array();
+            JSON::Elements elements = JSON::parse_stream(reader(string), chunk);
+            for (JSON& element : elements)
+                json[json.size()] = std::move(element);
+            assert(elements.status() == JSON::SUCCESS && json == expected);
+        }
+        std::string text(32, 'x');
+        std::string strings = "[\"" + text + "\", \"" + text + "\"]";
+        std::size_t count = 0;
+        for (const JSON& element : JSON::parse_stream(reader(strings)))
+            count += element.is_string();
+        assert(count == 2);
+        std::string long_element = "[[";  // scanned once across thousands of refills
+        for (std::size_t i = 0; i < 20000; ++i)
+            long_element += "\"\\\"]\", // ]\n[" + std::to_string(i) + "], ";
+        long_element += "{}]]";
+        count = 0;
+        for (const JSON& element : JSON::parse_stream(reader(long_element), 3))
+            count += element.size() == 40001 && element[39999] == JSON::array({19999});
+        assert(count == 1);
+        std::string rows = "[[1, \"a\", 2, 3, 4], [1, 2, 3, 4, 5, 6, 7, 8]]";
+        count = 0;
+        for (const JSON& element : JSON::parse_stream(reader(rows), 5)) {
+            count += element.get_array().capacity() == element.size();  // sized exactly
+#ifdef JSON_PACKED_ARRAYS
+            count += element.get_int64s().size() == 8;
+#endif  // JSON_PACKED_ARRAYS
+        }
+#ifdef JSON_PACKED_ARRAYS
+        assert(count == 3);
+#else   // JSON_PACKED_ARRAYS
+        assert(count == 2);
+#endif  // JSON_PACKED_ARRAYS
+        std::string invalid = "[1, \"a";
+        JSON::Elements elements = JSON::parse_stream(reader(invalid), 2);
+        count = 0;
+        for (const JSON& element : elements)
+            count += element == 1;
+        assert(count == 1 && elements.status() != JSON::SUCCESS);
+        std::string object = "{}";
+        JSON::Elements mismatch = JSON::parse_stream(reader(object));
+        assert(mismatch.begin() == mismatch.end() && mismatch.status() == JSON::TYPE_MISMATCH);
+        std::printf("success\n");
+    }
+
+    {
+        std::printf("dedupe: ");
+        std::string string = R"([
+            {"address": {"city": "x", "zip": [1, 2]}, "label": ["a", "b"]},
+            {"address": {"city": "x", "zip": [1, 2]}, "label": ["a", "b"]},
+            {"address": {"city": "y", "zip": [1, 2]}, "label": [1.0]},
+            {"label": [1]}
+        ])";
+        JSON json;
+        assert(json.parse(string));
+#ifdef JSON_COW
+        JSON expected;
+        assert(expected.parse(string));
+        json.dedupe();
+        const JSON& data = json;
+        assert(data == expected && data.dump() == expected.dump());
+        assert(data[0].find("address") == data[1].find("address"));  // shared objects
+        assert(data[0]["label"].get_array().data() == data[1]["label"].get_array().data());
+        assert(data[2]["address"]["zip"].get_array().data() ==
+               data[0]["address"]["zip"].get_array().data());
+        assert(data[2]["label"].get_array().data() != data[3]["label"].get_array().data());
+        json[1]["address"]["city"] = "z";  // copied on write
+        assert(data[0]["address"]["city"] == "x" && data[1]["address"]["city"] == "z");
+        assert(data[2]["address"]["zip"] == JSON::array({1, 2}));
+        JSON first = JSON::array({1, 2});
+        JSON& stale = first[0];  // taken before the copy, so it aliases the shared storage
+        JSON second = first;
+        stale = 5;
+        assert(first[0] == 5 && std::as_const(second)[0] == 5);
+        first[1] = 6;  // written through the accessor, copied first
+        assert(first[1] == 6 && std::as_const(second)[1] == 2);
+        JSON mixed = JSON::array({expected[0], JSON{}});  // already shared, then a fresh copy
+        assert(mixed[1].parse(R"({"address": {"city": "x", "zip": [1, 2]}, "label": ["a", "b"]})"));
+        mixed.dedupe();
+        const JSON& merged = mixed;
+        assert(merged[0].find("address") == merged[1].find("address"));
+#endif  // JSON_COW
+        std::printf("success\n");
+    }
+
+    {
+        std::printf("move: ");
+        std::vector<JSON> elements = {1, "two"};
+        const JSON* data = elements.data();
+        JSON json = JSON::array(std::move(elements));
+        assert(json.get_array().data() == data && json.size() == 2);
+        std::string text(64, 'x');
+        const char* chars = text.data();
+        JSON string;
+        assert(string.get_string(std::move(text)).data() == chars);
+        JSON list;
+        list.reserve(16);
+        assert(list.is_array() && list.get_array().capacity() == 16);
+        list.push_back(1);
+        list.emplace_back("two");
+        list.emplace_back(std::string(64, 'y'));
+        assert(list == JSON::array({1, "two", std::string(64, 'y')}));
+        JSON object;
+        object.emplace("a", 1);
+        object.emplace("b", JSON::array({2}));
+        assert(object.emplace("a", 3) == 1 && object["b"][0] == 2);  // existing members are kept
+        chars = list[2].get_string().data();
+        std::string taken = list[2].take_string();
+        assert(taken.data() == chars && list[2].is_null());
+        std::vector<JSON> array = list.take_array();
+        assert(array.size() == 3 && array[1] == "two" && list.is_null());
+        assert(object.take_object().size() == 2 && object.is_null());
+        assert(object.take_string().empty() && object.take_array().empty());
+        std::printf("success\n");
+    }
+
+    {
+        std::printf("memory: ");
+        JSON json;
+        json.reserve(100);
+        json.push_back(std::string(100, 'x'));
+        json[0].get_string().reserve(1000);
+        JSON object;
+        object.emplace(std::string(100, 'k'), JSON::array({1, 2}));
+        json.push_back(std::move(object));
+        JSON::Memory before = json.memory_usage();
+        assert(before.arrays >= 100 * sizeof(JSON) && before.strings > 1100 && before.objects > 0);
+        json.shrink_to_fit();
+        JSON::Memory after = json.memory_usage();
+        assert(after.arrays < before.arrays && after.strings < before.strings);
+        assert(after.strings < 300 && after.objects == before.objects);
+        assert(json[0] == std::string(100, 'x') && json[1][std::string(100, 'k')][1] == 2);
+        assert(JSON{1}.memory_usage().total() == 0);
+#ifdef JSON_COW
+        JSON twice = JSON::array({json, json});  // shared storage is counted once
+        assert(twice.memory_usage().total() < 2 * after.total());
+#endif  // JSON_COW
+        std::printf("success\n");
+    }
+
+    {
+        std::printf("limits: ");
+        static_assert(JSON::INVALID_KEY_TYPE == 3 && JSON::UNEXPECTED_STRING_END == 6);
+        static_assert(JSON::INVALID_PATCH == 19 && JSON::BYTES_EXCEEDED == 30);
+        std::string string = R"({"name": "abcdefghij", "values": [1, 2, 3, [4, 5]]})";
+        JSON json;
+        assert(json.parse(string, JSON::Limits{}, &status) && status == JSON::SUCCESS);
+        assert(json.parse(string, {.max_bytes = 1000, .max_nodes = 9, .max_string_length = 10,
+                                   .max_elements = 4}));
+        assert(!json.parse(string, {.max_nodes = 8}, &status) && status == JSON::NODES_EXCEEDED);
+        assert(!json.parse(string, {.max_string_length = 9}, &status));
+        assert(status == JSON::STRING_LENGTH_EXCEEDED);
+        assert(!json.parse(string, {.max_elements = 3}, &status));
+        assert(status == JSON::ELEMENTS_EXCEEDED);
+        assert(!json.parse(string, {.max_bytes = 100}, &status) && status == JSON::BYTES_EXCEEDED);
+        std::string huge = "[\"" + std::string(1 << 20, 'x') + "\"]";
+        assert(!json.parse(huge, {.max_bytes = 1 << 16}, &status));
+        assert(status == JSON::BYTES_EXCEEDED);
+        std::string keys = R"({"abcdefghijk": 1})";
+        assert(!json.parse(keys, {.max_string_length = 10}, &status));
+        assert(status == JSON::STRING_LENGTH_EXCEEDED);
+#ifdef JSON_RAW_NUMBERS
+        std::string digits = "[" + std::string(1 << 20, '7') + "]";  // rejected before it's copied
+        assert(!json.parse(digits, {.max_bytes = 1 << 16}, &status));
+        assert(status == JSON::BYTES_EXCEEDED);
+        assert(!json.parse(digits, {.max_string_length = 1 << 16}, &status));
+        assert(status == JSON::STRING_LENGTH_EXCEEDED);
+#endif  // JSON_RAW_NUMBERS
+        std::printf("success\n");
+    }
+
+    {
+        std::printf("reformat: ");
+        std::string string = R"({"b": [1, 2.5e-3, [], {}], "a": {"c": "x\"y", "d": null,},
+            // comment
+            "e": [true, false, "\u00e9"],})";
+        std::string minified = JSON::minify(string, &status);
+        assert(status == JSON::SUCCESS);
+        std::string expected =
+            R"({"b":[1,2.5e-3,[],{}],"a":{"c":"x\"y","d":null},"e":[true,false,"\u00e9"]})";
+        assert(minified == expected);
+        std::string sorted = R"({"a": {"c": "x", "d": [[1], {}]}, "b": [1, 2, []], "c": ""})";
+        JSON json;
+        assert(json.parse(sorted));
+        assert(JSON::minify(sorted) == json.dump() && JSON::prettify(sorted) == json.dump(true));
+        assert(JSON::prettify("[1,[2]]", 4) == "[\n    1,\n    [\n        2\n    ]\n]");
+        assert(JSON::minify(" 7 ") == "7" && JSON::minify("[]") == "[]");
+        assert(JSON::minify("[1, \"a", &status).empty() && status == JSON::UNEXPECTED_STRING_END);
+        assert(JSON::minify("{1: 2}", &status).empty() && status != JSON::SUCCESS);
+        assert(JSON::minify("[1, \"\\x\"]", &status).empty());
+        assert(status == JSON::INVALID_STRING_ESCAPE);
+        assert(JSON::minify(std::string(JSON_MAX_DEPTH + 2, '['), &status).empty());
+        assert(status == JSON::DEPTH_EXCEEDED);
+        std::printf("success\n");
+    }
+
     {
         std::printf("fallback: ");
         JSON json;
@@ -6,6 +6,7 @@
 
 #define JSON_IMPLEMENTATION
 #define JSON_STRICT
+#define JSON_VALIDATE_UTF8
 #include "json.hpp"
 
 #define COLOR_RESET "\033[0m"
@@ -129,6 +130,7 @@ const char* TESTS[] = {
     "n_object_emoji.json",
     "n_object_garbage_at_end.json",
     "n_object_key_with_single_quotes.json",
+    "n_object_lone_continuation_byte_in_key_and_trailing_comma.json",
     "n_object_missing_colon.json",
     "n_object_missing_key.json",
     "n_object_missing_semicolon.json",
@@ -259,28 +261,53 @@ const char* TESTS[] = {
     "y_object_duplicated_key_and_value.json",
     "y_object_empty.json",
     "y_object_empty_key.json",
+    "y_object_escaped_null_in_key.json",
     "y_object_extreme_numbers.json",
     "y_object_long_strings.json",
     "y_object_simple.json",
+    "y_object_string_unicode.json",
     "y_object_with_newlines.json",
+    "y_string_1_2_3_bytes_UTF-8_sequences.json",
+    "y_string_accepted_surrogate_pair.json",
+    "y_string_accepted_surrogate_pairs.json",
     "y_string_allowed_escapes.json",
     "y_string_backslash_and_u_escaped_zero.json",
     "y_string_backslash_doublequotes.json",
     "y_string_comments.json",
     "y_string_double_escape_a.json",
     "y_string_double_escape_n.json",
+    "y_string_escaped_control_character.json",
+    "y_string_escaped_noncharacter.json",
     "y_string_in_array.json",
     "y_string_in_array_with_leading_space.json",
+    "y_string_last_surrogates_1_and_2.json",
+    "y_string_nbsp_uescaped.json",
     "y_string_nonCharacterInUTF-8_U+10FFFF.json",
     "y_string_nonCharacterInUTF-8_U+FFFF.json",
+    "y_string_null_escape.json",
+    "y_string_one-byte-utf-8.json",
     "y_string_pi.json",
     "y_string_reservedCharacterInUTF-8_U+1BFFF.json",
     "y_string_simple_ascii.json",
     "y_string_space.json",
+    "y_string_surrogates_U+1D11E_MUSICAL_SYMBOL_G_CLEF.json",
+    "y_string_three-byte-utf-8.json",
+    "y_string_two-byte-utf-8.json",
     "y_string_u+2028_line_sep.json",
     "y_string_u+2029_par_sep.json",
+    "y_string_uEscape.json",
+    "y_string_uescaped_newline.json",
     "y_string_unescaped_char_delete.json",
+    "y_string_unicode.json",
+    "y_string_unicodeEscapedBackslash.json",
     "y_string_unicode_2.json",
+    "y_string_unicode_U+10FFFE_nonchar.json",
+    "y_string_unicode_U+1FFFE_nonchar.json",
+    "y_string_unicode_U+200B_ZERO_WIDTH_SPACE.json",
+    "y_string_unicode_U+2064_invisible_plus.json",
+    "y_string_unicode_U+FDD0_nonchar.json",
+    "y_string_unicode_U+FFFE_nonchar.json",
+    "y_string_unicode_escaped_double_quote.json",
     "y_string_utf8.json",
     "y_string_with_del_character.json",
     "y_structure_lonely_false.json",
@@ -293,45 +320,19 @@ const char* TESTS[] = {
     "y_structure_trailing_newline.json",
     "y_structure_true_in_array.json",
     "y_structure_whitespace_array.json",
-    "ny_object_escaped_null_in_key.json",                               // unicode
-    "ny_object_string_unicode.json",                                    // unicode
-    "ny_string_1_2_3_bytes_UTF-8_sequences.json",                       // unicode
-    "ny_string_accepted_surrogate_pair.json",                           // unicode
-    "ny_string_accepted_surrogate_pairs.json",                          // unicode
-    "ny_string_escaped_control_character.json",                         // unicode
-    "ny_string_escaped_noncharacter.json",                              // unicode
-    "ny_string_last_surrogates_1_and_2.json",                           // unicode
-    "ny_string_nbsp_uescaped.json",                                     // unicode
-    "ny_string_null_escape.json",                                       // unicode
-    "ny_string_one-byte-utf-8.json",                                    // unicode
-    "ny_string_surrogates_U+1D11E_MUSICAL_SYMBOL_G_CLEF.json",          // unicode
-    "ny_string_three-byte-utf-8.json",                                  // unicode
-    "ny_string_two-byte-utf-8.json",                                    // unicode
-    "ny_string_uEscape.json",                                           // unicode
-    "ny_string_uescaped_newline.json",                                  // unicode
-    "ny_string_unicode.json",                                           // unicode
-    "ny_string_unicodeEscapedBackslash.json",                           // unicode
-    "ny_string_unicode_U+10FFFE_nonchar.json",                          // unicode
-    "ny_string_unicode_U+1FFFE_nonchar.json",                           // unicode
-    "ny_string_unicode_U+200B_ZERO_WIDTH_SPACE.json",                   // unicode
-    "ny_string_unicode_U+2064_invisible_plus.json",                     // unicode
-    "ny_string_unicode_U+FDD0_nonchar.json",                            // unicode
-    "ny_string_unicode_U+FFFE_nonchar.json",                            // unicode
-    "ny_string_unicode_escaped_double_quote.json",                      // unicode
-    "yn_array_extra_comma.json",                                        // trailing comma
-    "yn_array_number_and_comma.json",                                   // trailing comma
-    "yn_number_-2..json",                                               // don't care
-    "yn_number_0.e1.json",                                              // don't care
-    "yn_number_2.e+3.json",                                             // don't care
-    "yn_number_2.e-3.json",                                             // don't care
-    "yn_number_2.e3.json",                                              // don't care
-    "yn_number_real_without_fractional_part.json",                      // don't care
-    "yn_object_lone_continuation_byte_in_key_and_trailing_comma.json",  // trailing comma
-    "yn_object_trailing_comma.json",                                    // trailing comma
-    "yn_object_trailing_comment_slash_open.json",                       // comment
-    "yn_string_unescaped_ctrl_char.json",                               // don't care
-    "yn_string_unescaped_newline.json",                                 // don't care
-    "yn_string_unescaped_tab.json",                                     // don't care
+    "yn_array_extra_comma.json",                    // trailing comma
+    "yn_array_number_and_comma.json",               // trailing comma
+    "yn_number_-2..json",                           // don't care
+    "yn_number_0.e1.json",                          // don't care
+    "yn_number_2.e+3.json",                         // don't care
+    "yn_number_2.e-3.json",                         // don't care
+    "yn_number_2.e3.json",                          // don't care
+    "yn_number_real_without_fractional_part.json",  // don't care
+    "yn_object_trailing_comma.json",                // trailing comma
+    "yn_object_trailing_comment_slash_open.json",   // comment
+    "yn_string_unescaped_ctrl_char.json",           // don't care
+    "yn_string_unescaped_newline.json",             // don't care
+    "yn_string_unescaped_tab.json",                 // don't care
 };
 
 static std::string read(const char* file);